@@ -50,6 +50,9 @@ void appMain () {
     uint8_t mem [12*1024];
     vecInit(mem, sizeof mem);
     objInit(mem, sizeof mem);
+    gcNursery(sizeof mem / 8);
+    Context::gcSlice = 1024; // max bytes of gc work per scheduler pass
+    vecFragLevel(25); // compact once a quarter of the vector space is free
     printf("main\n");
 
     auto task = vmLaunch(loadFile("?")); // TODO clitask
@@ -2,26 +2,77 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 using namespace monty;
 
 constexpr auto IMPORT_PATH = "../../v1.3/tests/py/%s.mpy";
 
+// Files are mapped read-only and never unmapped: code in the XIP format (see
+// the -x option below) then runs straight from the page cache, without a copy.
+
 static auto loadFile (char const* name) -> uint8_t const* {
-    auto fp = fopen(name, "rb");
-    if (fp == nullptr)
+    auto fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    auto p = fstat(fd, &st) == 0 && st.st_size > 0 ?
+        mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    return p != MAP_FAILED ? (uint8_t const*) p : nullptr;
+}
+
+// A bundle holds many modules in one file, see tools/bundle.py for details.
+// With MONTY_BUNDLE set, imports are looked up there first, without file I/O.
+
+struct BundleInfo {
+    uint32_t magic;
+    uint32_t size :24;
+    uint32_t flags :8;
+    char name [15], zero;
+    uint32_t time;
+    uint32_t crc;
+};
+static_assert(sizeof (BundleInfo) == 32, "incorrect header size");
+
+static BundleInfo const* bundle;
+
+static auto bundleFind (char const* name) -> uint8_t const* {
+    if (bundle == nullptr)
         return nullptr;
-    fseek(fp, 0, SEEK_END);
-    uint32_t bytes = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    auto data = (uint8_t*) malloc(bytes + 64);
-    fread(data, 1, bytes, fp);
-    fclose(fp);
-    return data;
+    uint32_t h = 2166136261; // FNV-1a
+    for (auto p = name; *p != 0; ++p)
+        h = (h ^ (uint8_t) *p) * 16777619;
+    auto slots = (uint32_t const*) (bundle + 1);
+    auto mask = bundle->size - 1;
+    for (auto i = h & mask; slots[i] != 0; i = (i + 1) & mask) {
+        auto info = (BundleInfo const*) ((uint8_t const*) bundle + slots[i]);
+        if (strncmp(info->name, name, sizeof info->name + 1) == 0)
+            return (uint8_t const*) (info + 1);
+    }
+    return nullptr;
+}
+
+static void bundleInit (char const* name) {
+    auto p = (BundleInfo const*) loadFile(name);
+    if (p != nullptr && p->magic == 0x4279746D) // 'mtyB'
+        bundle = p;
+    else
+        printf("%s: can't load bundle\n", name);
 }
 
 auto monty::vmImport (char const* name) -> uint8_t const* {
-    auto data = loadFile(name);
+    auto data = bundleFind(name);
+    if (data != nullptr)
+        return data;
+    data = loadFile(name);
     if (data != nullptr)
         return data;
     assert(strlen(name) < 25);
@@ -30,20 +81,187 @@ auto monty::vmImport (char const* name) -> uint8_t const* {
     return loadFile(buf);
 }
 
-int main (int argc, char const** argv) {
-    uint8_t mem [12*1024];
-    vecInit(mem, sizeof mem);
-    objInit(mem, sizeof mem);
-    printf("main\n");
+// The heap is a large reserved address range, of which only both ends are in
+// use: vectors grow up from the start, objects grow down from the end. Pages
+// are committed whenever either side needs more room, until the two meet.
+// Each step at least doubles that side, so the number of steps stays small.
+// With -DHUGE_PAGES, the kernel is asked to use transparent huge pages.
+// Each isolate (i.e. thread, see -j below) reserves and manages its own heap.
+
+constexpr size_t HEAP_RESERVE = 1UL << 30; // address space, not memory
+constexpr size_t HEAP_INIT = 64*1024;     // initial size of each side
+
+static ISOLATE uint8_t *heapStart, *heapLow, *heapHigh, *heapEnd;
+
+static auto heapCommit (void* p, size_t bytes) -> bool {
+    return mprotect(p, bytes, PROT_READ | PROT_WRITE) == 0;
+}
+
+// round up to whole pages, and at least as much as the current size
+static auto heapStep (uint32_t bytes, size_t used) -> size_t {
+    size_t page = sysconf(_SC_PAGESIZE);
+    auto n = bytes > used ? bytes : used;
+    return (n + page - 1) / page * page;
+}
+
+static auto growVecs (uint32_t bytes) -> void* {
+    auto n = heapStep(bytes, heapLow - heapStart);
+    if (heapLow + n > heapHigh || !heapCommit(heapLow, n))
+        return nullptr;
+    heapLow += n;
+    return heapLow;
+}
+
+static auto growObjs (uint32_t bytes) -> void* {
+    auto n = heapStep(bytes, heapEnd - heapHigh);
+    if (heapHigh - n < heapLow || !heapCommit(heapHigh - n, n))
+        return nullptr;
+    heapHigh -= n;
+    return heapHigh;
+}
+
+static void heapInit () {
+    auto p = mmap(nullptr, HEAP_RESERVE, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(p != MAP_FAILED);
+#if HUGE_PAGES && defined (MADV_HUGEPAGE)
+    madvise(p, HEAP_RESERVE, MADV_HUGEPAGE);
+#endif
+    heapStart = heapLow = (uint8_t*) p;
+    heapEnd = heapHigh = heapStart + HEAP_RESERVE;
+
+    growVecs(HEAP_INIT);
+    growObjs(HEAP_INIT);
+    vecInit(heapStart, heapLow - heapStart);
+    objInit(heapHigh, heapEnd - heapHigh);
+    vecGrow = growVecs;
+    objGrow = growObjs;
+}
+
+// With MONTY_IMAGE set, the heap is loaded from that file when it exists, or
+// else saved to it on exit, i.e. after all the imports: this skips them later.
 
-    auto task = argc > 1 ? vmLaunch(argv[1]) : nullptr; // TODO clitask
+static FILE* imageFile;
+
+static void imageWrite (void const* ptr, uint32_t bytes) {
+    fwrite(ptr, 1, bytes, imageFile);
+}
+
+// "nat-py -x in.mpy out.mpx" converts bytecode to the execute-in-place format
+
+static auto convert (char const* in, char const* out) -> int {
+    imageFile = fopen(out, "wb");
+    if (imageFile == nullptr)
+        return 1;
+    auto ok = vmConvert(loadFile(in), imageWrite);
+    fclose(imageFile);
+    if (!ok)
+        printf("%s: can't convert\n", in);
+    return ok ? 0 : 1;
+}
+
+static auto imageLoad (char const* name) -> bool {
+    auto fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    auto p = fstat(fd, &st) == 0 ?
+        mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    auto ok = HeapImage::load(p); // the pools grow as needed
+    munmap(p, st.st_size);
+    if (!ok)
+        printf("%s: can't load heap image\n", name);
+    return ok;
+}
+
+static void imageSave (char const* name) {
+    imageFile = fopen(name, "wb");
+    if (imageFile == nullptr)
+        return;
+    auto ok = HeapImage::save(imageWrite);
+    fclose(imageFile);
+    if (!ok) {
+        unlink(name);
+        printf("%s: can't save heap image\n", name);
+    }
+}
+
+static auto msNow (clockid_t id) -> uint32_t {
+    timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// the tunables are per isolate, so this is needed for each one
+static void vmSetup () {
+    gcNursery(HEAP_INIT / 8);
+    Context::gcSlice = 1024; // max bytes of gc work per scheduler pass
+    vecFragLevel(25); // compact once a quarter of the vector space is free
+}
+
+static auto vmRun (char const* name) -> bool {
+    auto task = vmLaunch(name);
     if (task != nullptr)
         Context::ready.append(task);
-    else
-        printf("no task\n");
 
     while (Context::runLoop())
         ; // TODO idling
 
+    return task != nullptr;
+}
+
+// "nat-py -j N mod..." runs the modules in N isolates at once, each with its
+// own heap and tasks, on its own thread. The isolates share nothing but the
+// bundle and mapped files, so with enough cores, the time should stay flat.
+
+static auto isolates (int n, int argc, char const** argv) -> int {
+    std::atomic<int> failed {0};
+    auto t = msNow(CLOCK_MONOTONIC);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < n; ++i)
+        threads.emplace_back([&]() {
+            heapInit();
+            vmSetup();
+            for (int j = 0; j < argc; ++j)
+                if (!vmRun(argv[j]))
+                    ++failed;
+        });
+    for (auto& e : threads)
+        e.join();
+
+    t = msNow(CLOCK_MONOTONIC) - t;
+    printf("%d isolates, %d modules: %d ms, %d failed\n",
+            n, n * argc, (int) t, (int) failed);
+    return failed > 0 ? 1 : 0;
+}
+
+int main (int argc, char const** argv) {
+    // both clocks are process-wide, but gc time is measured per thread
+    gcClock = []() { return msNow(CLOCK_THREAD_CPUTIME_ID); };
+    Event::clock = []() { return msNow(CLOCK_MONOTONIC); }; // for timeouts
+
+    auto bundleName = getenv("MONTY_BUNDLE");
+    if (bundleName != nullptr)
+        bundleInit(bundleName);
+    if (argc > 2 && strcmp(argv[1], "-j") == 0)
+        return isolates(atoi(argv[2]), argc - 3, argv + 3);
+
+    heapInit();
+    if (argc == 4 && strcmp(argv[1], "-x") == 0)
+        return convert(argv[2], argv[3]);
+    auto image = getenv("MONTY_IMAGE");
+    auto loaded = image != nullptr && imageLoad(image);
+    vmSetup();
+    printf("main\n");
+
+    if (argc < 2 || !vmRun(argv[1])) // TODO clitask
+        printf("no task\n");
+
+    if (image != nullptr && !loaded)
+        imageSave(image);
     printf("done\n");
 }
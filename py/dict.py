@@ -67,4 +67,8 @@ print(next(i))
 print(next(i))
 print(next(i))
 
+print(120)
+for k, v in a.items():
+    print(k, v)
+
 [1,2,3].clear() # wrong place
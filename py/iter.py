@@ -23,6 +23,14 @@ print(type(iter(c)))
 for i in c:
     print(i)
 
+d = [1,2]
+for i in d:
+    if i < 4:
+        d.append(i+2)
+    print(i)
+for k in {7:77,8:88}:
+    print(k)
+
 print(200)
 print(tuple())
 print(tuple((1,2,3)))
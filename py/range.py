@@ -3,3 +3,13 @@ print(len(r), r)
 
 for i in r:
     print(i)
+
+for i in range(10,0,-4):
+    print(i)
+for i in range(3,3):
+    print(i)
+
+n = 0
+for i in range(1000):
+    n += i
+print(n)
@@ -0,0 +1,27 @@
+a = [3, 1, 2]
+a.sort()
+print(a)
+a.sort(reverse=True)
+print(a)
+
+print(sorted(["list", "abs", "dict"]))
+print(sorted((5, 3, 9, 1)))
+print(sorted([-3, 1, -2], key=abs))
+print(sorted([-3, 1, -2], key=abs, reverse=True))
+
+def neg(x):
+    return -x
+a = [5, 2, 8]
+a.sort(key=neg)
+print(a)
+print(sorted(["bb", "a", "cc", "b"], key=lambda s: len(s)))
+
+try:
+    sorted([2, 0, 1], key=lambda x: 10 // x)
+except ZeroDivisionError:
+    print("key raised")
+
+try:
+    sorted(["a", 1])
+except TypeError:
+    print("mixed types")
@@ -29,3 +29,570 @@ TEST_CASE("dash") {
     Vec::compact();
     //FIXME CHECK(memAvail == gcMax());
 }
+
+static int spares;
+
+static void countSpares (Obj const& o, uint32_t) {
+    if (&((Object const&) o).type() == &Spare::info)
+        ++spares;
+}
+
+static auto numSpares () -> int {
+    spares = 0;
+    Obj::walk(countSpares);
+    return spares;
+}
+
+TEST_CASE("recycler") {
+    uint8_t memory [8*1024];
+    vecInit(memory, sizeof memory);
+    objInit(memory, sizeof memory);
+    auto avail = gcMax();
+
+    for (int i = 0; i < 100; ++i)
+        Int::make(1LL << 40); // enough allocations to keep 12 slots
+    Recycler::clearAll();
+    Object::sweep();
+    CHECK(numSpares() == 12);
+
+    SUBCASE("re-use") {
+        Value v [12];
+        for (int i = 0; i < 12; ++i) {
+            v[i] = Int::make(i + (1LL << 40));
+            CHECK(v[i].asInt() == i + (1LL << 40));
+            CHECK(numSpares() == 11 - i);
+        }
+        Value w = Int::make(1LL << 40); // this one needs a new slot
+        CHECK(numSpares() == 0);
+        CHECK(w.asInt() == 1LL << 40);
+    }
+
+    SUBCASE("release") {
+        Recycler::markAll(); // kept slots are roots until cleared
+        Object::sweep();
+        CHECK(numSpares() == 12);
+        Recycler::clearAll();
+        Object::sweep();
+        CHECK(numSpares() == 0);
+        CHECK(gcMax() == avail);
+    }
+
+    Recycler::clearAll();
+    Object::sweep();
+}
+
+static uint8_t imageData [2048];
+static uint32_t imageFill;
+
+static void imageWrite (void const* ptr, uint32_t bytes) {
+    REQUIRE(imageFill + bytes <= sizeof imageData);
+    memcpy(imageData + imageFill, ptr, bytes);
+    imageFill += bytes;
+}
+
+// bytes with their data elsewhere, as done for channel messages
+struct Shared : Bytes {
+    Shared (void const* p, uint32_t n) : Bytes (SHARED, p, n) {}
+};
+
+TEST_CASE("heap image") {
+    uint8_t mem1 [4*1024];
+    static uint8_t mem2 [8*1024];
+    vecInit(mem1, 2*1024);
+    objInit(mem1 + 2*1024, 2*1024);
+    Module::loaded._chain = &Module::builtins; // as set up in qstr.cpp
+    Module::builtins.at("modules") = Module::loaded; // as in the sys module
+
+    auto id = Q::make("<image-test>");
+    auto l = new List;
+    l->append(Int::make(1LL << 40));
+    l->append(new Str ("abc"));
+    l->append("def");
+    l->append(Q (id));
+    auto addr = (uintptr_t) l; // raw data which looks like a pointer
+    l->append(Int::make(addr));
+    l->append(new Bytes (&addr, sizeof addr));
+    Module::loaded.at("xyz") = l;
+    new List; // garbage
+
+    imageFill = 0;
+    CHECK(HeapImage::save(imageWrite));
+    auto fill = imageFill;
+    CHECK(fill > 0);
+
+    Module::loaded.at("abc") = new Shared (&addr, sizeof addr);
+    CHECK(!HeapImage::save(imageWrite)); // refers to data outside the heap
+    CHECK(imageFill == fill);
+
+    Module::loaded.clear();
+    Module::builtins.clear();
+    qstrCleanup();
+    vecInit(mem2 + 100, 32); // in a different spot this time, and too small
+    objInit(mem2 + 8*1024 - 64, 64);
+    vecGrow = [](uint32_t) -> void* { return mem2 + 100 + 3*1024; };
+    objGrow = [](uint32_t) -> void* { return mem2 + 4*1024; };
+    CHECK(HeapImage::load(imageData)); // the pools grow as needed
+    CHECK(!HeapImage::load(imageData)); // the pools are no longer empty
+    vecGrow = nullptr;
+    objGrow = nullptr;
+
+    CHECK(Q::find("<image-test>") == id);
+    Value v = Module::loaded.at("xyz");
+    CHECK(Obj::inPool(&v.obj()));
+    auto& r = v.asType<List>();
+    CHECK(r.size() == 6);
+    CHECK(r[0].asInt() == 1LL << 40);
+    CHECK(strcmp(r[1].asType<Str>(), "abc") == 0);
+    CHECK(strcmp(r[2], "def") == 0);
+    CHECK(r[3].asQid() == id);
+    CHECK(r[4].asInt() == (int64_t) addr); // raw data has not been relocated
+    CHECK(memcmp(r[5].asType<Bytes>().begin(), &addr, sizeof addr) == 0);
+
+    Context::gcAll(); // the restored heap is consistent
+    CHECK(r.size() == 6);
+
+    Module::loaded.clear();
+    Module::builtins.clear();
+    qstrCleanup();
+    Module::loaded._chain = nullptr;
+}
+
+// a task which requeues itself at the tail, until it has run often enough
+struct Spinner : Context {
+    auto run () -> bool override {
+        if (_last >= 0 && switches - _last != tasks)
+            fair = false; // all other tasks must have run once in between
+        _last = switches++;
+        if (--_left > 0)
+            ready.append(this);
+        current = nullptr;
+        return false;
+    }
+
+    int _left = 0;
+    int _last = -1;
+
+    static ISOLATE int switches, tasks;
+    static ISOLATE bool fair;
+};
+
+ISOLATE int Spinner::switches;
+ISOLATE int Spinner::tasks;
+ISOLATE bool Spinner::fair;
+
+// a task which waits once, with a timeout, and then notes how it was resumed
+struct Waiter : Context {
+    auto run () -> bool override {
+        if (_evt != nullptr) {
+            auto& e = *_evt;
+            _evt = nullptr;
+            e.wait(_ms); // suspends
+        } else {
+            _timedOut = _transfer.isFalse();
+            _wasSet = _transfer.isTrue();
+            done->append(this);
+            current = nullptr;
+        }
+        return false;
+    }
+
+    Event* _evt = nullptr;
+    int _ms = -1;
+    bool _timedOut = false;
+    bool _wasSet = false;
+    static List* done;
+};
+
+List* Waiter::done;
+static uint32_t fakeNow;
+
+// an object which notes its own deletion
+struct Probe : Object {
+    ~Probe () override { ++gone; }
+    static int gone;
+};
+
+int Probe::gone;
+
+// an arena task: it allocates temporaries and keeps one, then ends on its
+// next run, its non-empty stack shows that it hasn't finished in between
+struct Burst : Context {
+    auto run () -> bool override {
+        if (size() == 0) {
+            append(1);
+            for (int i = 0; i < 100; ++i)
+                new Probe; // garbage right away
+            kept = new Probe;
+            Module::loaded.at("kept") = kept;
+            ready.append(this);
+        } else
+            clear();
+        current = nullptr;
+        return false;
+    }
+
+    static Probe* kept;
+};
+
+Probe* Burst::kept;
+
+// a task which allocates an object while an arena is open
+struct Bystander : Context {
+    auto run () -> bool override {
+        made = new Probe;
+        Module::loaded.at("made") = made;
+        current = nullptr;
+        return false;
+    }
+
+    static Probe* made;
+};
+
+Probe* Bystander::made;
+
+// a task which keeps the exception raised while it was current
+struct Catcher : Context {
+    auto run () -> bool override { current = nullptr; return false; }
+    void raise (Value v) override { caught = v; }
+    Value caught;
+};
+
+// a task which counts how often the gc traces it
+struct Traced : Waiter {
+    void marker () const override { Waiter::marker(); ++traces; }
+    mutable int traces = 0;
+};
+
+// runLoop must always be called at the same stack depth, hence a single test
+TEST_CASE("tasks") {
+    static uint8_t memory [256*1024];
+    vecInit(memory, sizeof memory / 2);
+    objInit(memory + sizeof memory / 2, sizeof memory / 2);
+    Module::loaded._chain = &Module::builtins; // as set up in qstr.cpp
+    Module::builtins.at("modules") = Module::loaded; // as in the sys module
+
+    { // run queue: context switch rate and fairness
+        static int const sizes [] = { 10, 100, 1000 };
+        for (auto n : sizes) {
+            Spinner::switches = 0;
+            Spinner::tasks = n;
+            Spinner::fair = true;
+            for (int i = 0; i < n; ++i) {
+                auto t = new Spinner;
+                t->_left = 100000 / n;
+                Context::ready.append(t);
+            }
+
+            auto t0 = clock();
+            while (Context::runLoop()) {}
+            auto secs = (double) (clock() - t0) / CLOCKS_PER_SEC;
+            MESSAGE(n, " tasks: ", (int) (100000 / secs), " switches/sec");
+
+            CHECK(Spinner::switches == 100000);
+            CHECK(Spinner::fair);
+            CHECK(Context::ready.len() == 0);
+        }
+    }
+
+    { // timeouts: shared by all events, in order, and removed when set
+        Event::clock = []() { return fakeNow; };
+        fakeNow = -100; // also check that the clock can wrap around
+
+        auto e1 = new Event, e2 = new Event;
+        Module::loaded.at("e1") = e1; // keep both events alive
+        Module::loaded.at("e2") = e2;
+        Waiter::done = new List;
+        Module::loaded.at("done") = Waiter::done;
+
+        constexpr int N = 100;
+        static Waiter* tasks [N];
+        for (int i = 0; i < N; ++i) {
+            auto t = tasks[i] = new Waiter;
+            t->_evt = i % 10 == 0 ? e2 : e1;
+            t->_ms = ((i * 37) % 200 + 1) * 1000; // up to 200 s, well past 60 s
+            Context::ready.append(t);
+        }
+        tasks[N-1]->_ms = -1; // this one never times out
+
+        CHECK(Context::runLoop()); // all tasks are now waiting
+        CHECK(Event::dues.size() == N - 1);
+
+        e2->set(); // resume these right away, their timers must be removed
+        CHECK(Context::runLoop());
+        CHECK(Waiter::done->size() == N / 10);
+        CHECK(Event::dues.size() == N - 1 - N / 10);
+        for (auto e : *Waiter::done) {
+            CHECK(!e.asType<Waiter>()._timedOut);
+            CHECK(e.asType<Waiter>()._wasSet);
+        }
+        Waiter::done->clear();
+
+        // advance the clock in steps, tasks must time out in the proper order
+        uint32_t last = 0;
+        for (uint32_t t = 0; t <= 200; ++t) {
+            fakeNow = t * 1000 - 100 + 999;
+            Context::runLoop();
+            for (auto e : *Waiter::done) {
+                auto& w = e.asType<Waiter>();
+                CHECK(w._timedOut);
+                CHECK(!w._wasSet);
+                CHECK(w._ms >= (int) last);
+                CHECK(w._ms <= (int) t * 1000 + 999);
+                last = w._ms;
+            }
+            Waiter::done->clear();
+        }
+        CHECK(Event::dues.size() == 0);
+        CHECK(Context::runLoop() == false); // nothing left but e1's last task
+
+        e1->set();
+        Context::runLoop();
+        CHECK(Waiter::done->size() == 1);
+        CHECK(!(*Waiter::done)[0].asType<Waiter>()._timedOut);
+        CHECK((*Waiter::done)[0].asType<Waiter>()._wasSet);
+        Waiter::done->clear();
+
+        CHECK(e1->wait(1000).isTrue()); // already set, so it doesn't suspend
+        CHECK(Event::dues.size() == 0);
+    }
+
+    { // incremental gc: a black task's _transfer must be traced at the end
+        auto probe = new Probe; // allocated before the gc, only held here
+        Probe::gone = 0;
+        auto t1 = new Waiter;
+        auto t2 = new Traced;
+        Context::ready.append(t1);
+        Context::ready.append(t2); // traced before t1
+
+        bool stored = false;
+        while (!Context::gcStep(1))
+            if (t2->traces > 0 && !stored) {
+                CHECK(Probe::gone == 0); // must still be in the mark phase
+                t2->_transfer = probe; // as done when a task is resumed
+                stored = true;
+            }
+        CHECK(stored);
+        CHECK(Probe::gone == 0);
+        CHECK(t2->_transfer.isObj());
+
+        Context::ready.pull();
+        Context::ready.pull();
+    }
+
+    { // arena: only has the arena task's objects, released when it ends
+        Module::loaded.clear();
+        Context::gcAll(); // make room for bump allocation
+
+        Module::loaded.at("high") = new Probe;
+        new (1000) Probe; // this leaves a free slot, above all new objects
+        Module::loaded.at("low") = new Probe;
+        Context::gcAll();
+        Probe::gone = 0;
+
+        auto burst = new Burst;
+        burst->_arena = true;
+        Context::ready.append(burst);
+        Context::ready.append(new Bystander);
+
+        CHECK(Context::runLoop() == false);
+        CHECK(Probe::gone == 100); // released without a gc
+        Value kept = Module::loaded.at("kept");
+        CHECK(&kept.obj() == Burst::kept); // escaped, so it survived
+        CHECK((void*) Bystander::made > (void*) Burst::kept); // not in arena
+    }
+
+    { // sys.arena: only tasks are accepted, anything else is a TypeError
+        Value arena = ext_sys.getAt("arena");
+        REQUIRE(arena.isObj());
+        auto task = new Catcher;
+        Context::current = task;
+        Vector args;
+        args.insert(0);
+
+        args[0] = new Probe;
+        arena->call(args);
+        CHECK(task->caught.isObj()); // raised, and nothing was written
+        CHECK(task->caught.asType<Exception>().binop(BinOp::ExceptionMatch,
+                    Module::builtins.getAt("TypeError")).truthy());
+
+        task->caught = {};
+        args[0] = task;
+        arena->call(args);
+        CHECK(task->caught.isNil());
+        CHECK(task->_arena);
+
+        Context::current = nullptr;
+        args.clear();
+    }
+
+    Module::loaded.clear();
+    Module::builtins.clear();
+    Context::gcAll();
+    Module::loaded._chain = nullptr;
+    Event::clock = nullptr;
+}
+
+// each thread is an isolate, with its own pools and tasks: they scale out
+TEST_CASE("isolates") {
+    constexpr int N = 4, SWITCHES = 100000;
+    static uint8_t memory [N][64*1024];
+    for (int n = 1; n <= N; n *= 2) {
+        std::atomic<int> good {0};
+        std::thread threads [N];
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; ++i)
+            threads[i] = std::thread ([&good, i]() {
+                auto mem = memory[i];
+                vecInit(mem, sizeof memory[i] / 2);
+                objInit(mem + sizeof memory[i] / 2, sizeof memory[i] / 2);
+                Module::loaded._chain = &Module::builtins;
+
+                Spinner::switches = 0;
+                Spinner::tasks = 100;
+                Spinner::fair = true;
+                for (int j = 0; j < Spinner::tasks; ++j) {
+                    auto t = new Spinner;
+                    t->_left = SWITCHES / Spinner::tasks;
+                    Context::ready.append(t);
+                }
+                while (Context::runLoop()) {}
+
+                if (Spinner::switches == SWITCHES && Spinner::fair)
+                    ++good;
+            });
+        for (int i = 0; i < n; ++i)
+            threads[i].join();
+        std::chrono::duration<double> secs =
+            std::chrono::steady_clock::now() - t0;
+
+        MESSAGE(n, " isolates: ", (int) (n * SWITCHES / secs.count()),
+                    " switches/sec");
+        CHECK(good == n);
+    }
+}
+
+// a task which receives messages, and checks their type, size, and contents
+struct Receiver : Context {
+    auto run () -> bool override {
+        if (_transfer.isOk()) // resumed by the channel, with a message
+            check(_transfer.take());
+        else {
+            auto msg = _chan->recv();
+            if (current != nullptr) // else suspended, waiting for a message
+                check(msg);
+        }
+        if (_count >= _total)
+            current = nullptr; // done
+        return false; // back to the run loop, which can then collect garbage
+    }
+
+    void check (Value msg) {
+        auto i = _count++;
+        auto& b = msg.asObj();
+        auto ok = &b.type() == (i % 4 == 1 ? &Str::info : &Bytes::info) &&
+                    (int) b.len() == msgSize(i);
+        auto& bytes = (Bytes&) b;
+        if (ok && bytes.begin()[0] != (uint8_t) ('A' + i % 26))
+            ok = false;
+        if (ok && msgSize(i) > 48 && monty::Vec::inPool(bytes.begin()))
+            ok = false; // large ones should have been handed off, not copied
+        if (!ok)
+            ++_bad;
+    }
+
+    // every 4th message is large, the one after it is a str
+    static auto msgSize (int i) -> int { return i % 4 == 0 ? 1000 : 20; }
+
+    Channel* _chan = nullptr;
+    int _count = 0, _total = 0, _bad = 0;
+};
+
+// one isolate sends, another one receives, with the ring often full or empty
+TEST_CASE("channels") {
+    constexpr int N = 20000;
+    static uint8_t memory [2][256*1024];
+    std::atomic<bool> opened {false};
+    std::atomic<int> sent {0}, received {0}, bad {0};
+
+    auto setup = [](uint8_t* mem) {
+        vecInit(mem, sizeof memory[0] / 2);
+        objInit(mem + sizeof memory[0] / 2, sizeof memory[0] / 2);
+        Module::loaded._chain = &Module::builtins;
+        Module::builtins.at("modules") = Module::loaded;
+    };
+    auto cleanup = []() {
+        Module::loaded.clear();
+        Module::builtins.clear();
+        Context::gcAll(); // this deletes the channel
+        Module::loaded._chain = nullptr;
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread receiver ([&]() {
+        setup(memory[0]);
+        auto ch = new Channel ("test", 256);
+        Module::loaded.at("ch") = ch;
+        auto t = new Receiver;
+        t->_chan = ch;
+        t->_total = N;
+        Module::loaded.at("t") = t;
+        Context::ready.append(t);
+        opened = true;
+
+        while (Context::runLoop()) {}
+        received = t->_count;
+        bad = t->_bad;
+        cleanup();
+    });
+
+    std::thread sender ([&]() {
+        setup(memory[1]);
+        while (!opened) {}
+        auto ch = new Channel ("test", 0);
+        Module::loaded.at("ch") = ch;
+
+        uint8_t buf [1000];
+        for (int i = 0; i < N; ++i) {
+            if (gcCheck())
+                Context::gcAll(); // there is no run loop to do this
+            memset(buf, 'A' + i % 26, sizeof buf);
+            auto n = Receiver::msgSize(i);
+            Value msg;
+            if (i % 4 == 1)
+                msg = new Str ((char const*) buf, n);
+            else
+                msg = new Bytes (buf, n);
+            while (ch->send(msg).isFalse())
+                std::this_thread::yield(); // the ring is full
+            ++sent;
+        }
+        cleanup();
+    });
+
+    sender.join();
+    receiver.join();
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - t0;
+    MESSAGE("channel: ", (int) (N / secs.count()), " msgs/sec");
+
+    CHECK(sent == N);
+    CHECK(received == N);
+    CHECK(bad == 0);
+
+    // a receiver's isolate can end without deleting its channel, after which
+    // sends must not touch any of its state, only the (now orphaned) ring
+    std::thread ([&]() {
+        setup(memory[0]);
+        auto ch = new Channel ("orphan", 4);
+        ch->send("abc");
+        received = ch->recv().isObj(); // this makes it the receiver
+    }).join();
+    std::thread ([&]() {
+        setup(memory[1]);
+        auto ch = new Channel ("orphan", 0);
+        sent = ch->send("def").isTrue();
+        cleanup();
+    }).join();
+    CHECK(received == 1);
+    CHECK(sent == 1);
+}
@@ -7,6 +7,7 @@
 
 #include <cassert>
 #include <cstdlib> // needed for strtoll on linux
+#include <new>
 
 extern "C" int printf (char const*, ...);
 
@@ -27,10 +28,16 @@ Lookup const Int::attrs;
 Lookup const Range::attrs;
 Lookup const Slice::attrs;
 
+Type Spare::info (Q(0,"<spare>"));
+
+ISOLATE Recycler* Recycler::chain;
+ISOLATE Recycler Int::cache (sizeof (Int));
+ISOLATE Recycler Iterator::cache (sizeof (Iterator));
+
 constexpr int QID_RAM_BASE = 32*1024; // TODO arbitrary choice, currently
 
 static VaryVec qstrBaseMap (qstrBase, qstrBaseLen);
-static VaryVec qstrRamMap;
+ISOLATE VaryVec monty::qstrRamMap;
 
 void monty::qstrCleanup () {
     qstrRamMap.clear();
@@ -386,6 +393,47 @@ void Bool::repr (Buffer& buf) const {
     buf << (this == &falseObj ? "false" : "true");
 }
 
+auto Recycler::take (size_t bytes) -> void* {
+    sync();
+    ++_count;
+    if (_fill == 0 || bytes != _bytes)
+        return Obj::operator new (bytes);
+    auto p = _slots[--_fill];
+    p->~Spare();
+    return Obj::recycle(p);
+}
+
+void Recycler::give (void* p, size_t bytes) {
+    sync();
+    if (_fill < _limit && bytes == _bytes)
+        _slots[_fill++] = ::new (p) Spare;
+    else
+        Obj::operator delete (p);
+}
+
+// the pool has been re-initialised, so all slots kept so far are gone
+void Recycler::sync () {
+    if (_epoch != objEpoch()) {
+        _epoch = objEpoch();
+        _fill = _count = 0;
+    }
+}
+
+void Recycler::markAll () {
+    for (auto r = chain; r != nullptr; r = r->_next)
+        for (int i = 0; i < r->_fill; ++i)
+            mark(r->_slots[i]);
+}
+
+// keep about one slot per 8 allocations in the last cycle, up to MAX
+void Recycler::clearAll () {
+    for (auto r = chain; r != nullptr; r = r->_next) {
+        r->sync();
+        r->_limit = r->_count / 8 < MAX ? r->_count / 8 : MAX;
+        r->_fill = r->_count = 0;
+    }
+}
+
 auto Int::make (int64_t i) -> Value {
     Value v = (int) i;
     return i == (int) v ? v : new Int (i);
@@ -561,6 +609,11 @@ void Slice::repr (Buffer& buf) const {
 
 #if DOCTEST
 #include <doctest.h>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+extern Module ext_sys; // as found by "import sys", see mod-sys.cpp
 namespace {
 #include "dash-test.h"
 }
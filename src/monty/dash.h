@@ -6,10 +6,13 @@ namespace monty {
     struct Type;
     struct Range;
     struct RawIter;
+    struct VaryVec;
+    struct Context;
 
     extern char const qstrBase [];
     extern int const qstrBaseLen;
     void qstrCleanup ();
+    extern ISOLATE VaryVec qstrRamMap; // the qstrs added at run time
 
     struct Q {
         constexpr Q (uint16_t id, char const* =nullptr) : _id (id) {}
@@ -227,11 +230,13 @@ namespace monty {
         void clear () { _fill = 0; adj(0); }
 
         using Vec::compact; // allow public access
+        using Vec::compactStep;
     };
 
     using Vector = VecOf<Value>;
 
     void markVec (Vector const&);
+    auto sortVec (Vector&, Value key ={}, bool rev =false) -> Value;
 
     struct ArgVec {
         static constexpr auto SPREAD = 1<<16; // if "*arg" or "**kw" present
@@ -285,6 +290,13 @@ namespace monty {
         virtual auto copy  (Range const&) const -> Value;
         virtual auto store (Range const&, Object const&) -> Value;
 
+        // heap images: data which holds no pointers, in or outside the object
+        virtual auto rawData (uint32_t&) const -> void const* {
+            return nullptr;
+        }
+        // tasks can be told apart from all other objects, e.g. by sys.arena
+        virtual auto asTask () -> Context* { return nullptr; }
+
         auto sliceGetter (Value k) const -> Value;
         auto sliceSetter (Value k, Value v) -> Value;
     };
@@ -295,6 +307,38 @@ namespace monty {
         void operator delete (void*) {}
     };
 
+    // placeholder for an object slot which is kept for re-use, see Recycler
+    struct Spare : Object {
+        static Type info;
+        auto type () const -> Type const& override { return info; }
+    };
+
+    // A recycler keeps the slots of deleted objects of one type, so that new
+    // ones can skip the free list search. Kept slots hold a Spare and act as
+    // roots, until forgotten at the start of each full gc: it's then up to the
+    // gc to reclaim them. The limit is based on the allocation count since.
+    struct Recycler {
+        Recycler (uint32_t bytes) : _bytes (bytes), _next (chain) {
+            chain = this;
+        }
+
+        auto take (size_t bytes) -> void*;
+        void give (void* p, size_t bytes);
+
+        static void markAll ();
+        static void clearAll ();
+    private:
+        void sync ();
+
+        static constexpr auto MAX = 16;
+        static ISOLATE Recycler* chain;
+
+        uint32_t _bytes, _count =0, _epoch =0;
+        Recycler* _next;
+        uint8_t _fill =0, _limit =MAX/4;
+        Spare* _slots [MAX];
+    };
+
     void Value::marker () const { if (isObj()) mark(obj()); }
 
     //CG1 type <none>
@@ -330,9 +374,17 @@ namespace monty {
 
         operator int64_t () const { return _i64; }
 
+        auto rawData (uint32_t& n) const -> void const* override {
+            n = sizeof _i64;
+            return (Object const*) this + 1; // i.e. &_i64, which is packed
+        }
+
         auto unop (UnOp) const -> Value override;
         auto binop (BinOp, Value) const -> Value override;
 
+        auto operator new (size_t bytes) -> void* { return cache.take(bytes); }
+        void operator delete (void* p, size_t bytes) { cache.give(p, bytes); }
+        static ISOLATE Recycler cache;
     private:
         int64_t _i64 __attribute__((packed));
     }; // packing gives a better fit on 32b arch, and has no effect on 64b
@@ -361,6 +413,10 @@ namespace monty {
         auto next () -> Value override { return stepper(); }
 
         void marker () const override { _obj.marker(); }
+
+        auto operator new (size_t bytes) -> void* { return cache.take(bytes); }
+        void operator delete (void* p, size_t bytes) { cache.give(p, bytes); }
+        static ISOLATE Recycler cache;
     };
 
     auto Value::begin () const -> RawIter { return *this; }
@@ -374,6 +430,11 @@ namespace monty {
 
         Range (int from, int to, int by) : _from (from), _to (to), _by (by) {}
 
+        auto rawData (uint32_t& n) const -> void const* override {
+            n = 3 * sizeof (int32_t);
+            return &_from;
+        }
+
         int32_t _from, _to, _by;
     };
 
@@ -399,6 +460,15 @@ namespace monty {
         auto getAt (Value k) const -> Value override;
         auto iter () const -> Value override { return 0; }
         auto copy (Range const&) const -> Value override;
+        auto rawData (uint32_t& n) const -> void const* override {
+            n = cap();
+            return begin();
+        }
+
+    protected:
+        enum Shared { SHARED }; // the data is used in place, without a copy
+        Bytes (Shared, void const* p, uint32_t n)
+                    : ByteVec ((uint8_t const*) p, n) {}
     };
 
     //CG1 type str
@@ -410,6 +480,9 @@ namespace monty {
         auto unop (UnOp) const -> Value override;
         auto binop (BinOp, Value) const -> Value override;
         auto getAt (Value k) const -> Value override;
+
+    protected:
+        Str (Shared, char const* s, uint32_t n) : Bytes (SHARED, s, n) {}
     };
 
     //CG1 type <buffer>
@@ -486,6 +559,9 @@ namespace monty {
         Tuple (Value);
         Tuple (ArgVec const&);
 
+        // small tuples keep their items inline, right after the object header
+        static auto make (ArgVec const&) -> Value;
+
         void printer (Buffer&, char const*) const;
 
         auto len () const -> uint32_t override { return _fill; }
@@ -496,16 +572,21 @@ namespace monty {
         void marker () const override { markVec(*this); }
 
         static Tuple const emptyObj;
+        static constexpr uint32_t inlineMax = 8;
+    private:
+        struct Inline {};
+        Tuple (Inline, ArgVec const&);
     };
 
     //CG1 type list
     struct List : Tuple {
         using Tuple::Tuple;
 
-        //CG: wrap List pop append clear
+        //CG: wrap List pop append clear sort
         auto pop (int idx) -> Value;
         auto append (Value v) -> Value;
         auto clear () -> Value { Vector::clear(); return {}; }
+        auto sort (ArgVec const&) -> Value;
 
         auto setAt (Value k, Value v) -> Value override;
         auto store (Range const&, Object const&) -> Value override;
@@ -558,6 +639,27 @@ namespace monty {
         Object const* _chain {nullptr};
     };
 
+    // was: CG3 type <dictview>
+    struct DictView : Object {
+        static Type info;
+        auto type () const -> Type const& override { return info; }
+
+        DictView (Dict const& dict, int vtype) : _dict (dict), _vtype (vtype) {}
+
+        auto len () const -> uint32_t override { return _dict._fill; }
+        auto getAt (Value k) const -> Value override;
+        auto iter () const -> Value override { return 0; }
+
+        void marker () const override { _dict.marker(); }
+
+        auto operator new (size_t bytes) -> void* { return cache.take(bytes); }
+        void operator delete (void* p, size_t bytes) { cache.give(p, bytes); }
+        static ISOLATE Recycler cache;
+
+        Dict const& _dict;
+        int _vtype; // 0 = keys, 1 = values, 2 = items
+    };
+
     //CG1 type type
     struct Type : Dict {
         using Factory = auto (*)(ArgVec const&,Type const*) -> Value;
@@ -629,17 +731,43 @@ namespace monty {
         //CG: wrap Event wait set clear
         auto set () -> Value;
         auto clear () -> Value { _value = false; return {}; }
-        auto wait (int ms =60000) -> Value;
+        auto wait (int ms =-1) -> Value; // no timeout if < 0
 
-        auto triggerExpired (uint32_t now) -> uint32_t;
+        static void expire (uint32_t now); // resume all timed-out tasks
 
-        static int queued;
-        static Vector triggers;
+        static ISOLATE int queued;
+        static ISOLATE Vector triggers;
+        static ISOLATE Vector timers; // [task, event] pairs, in a min-heap
+        static ISOLATE VecOf<uint32_t> dues; // deadline of each timers entry
+        static auto (*clock) () -> uint32_t; // in ms, needed for timeouts
     protected:
         Vector _queue;
         bool _value = false;
         int8_t _id = -1;
-        uint16_t _deadline;
+    };
+
+    struct ChanRing; // the part which is shared between isolates
+
+    // A channel passes bytes and str messages between isolates, or between
+    // tasks in the same one. All channels with the same name share a ring,
+    // which is outside the pools. Sends never block, they return False when
+    // the ring is full. The first call to recv makes that channel the only
+    // receiver, its tasks wait for messages as with an event.
+    //CG1 type channel
+    struct Channel : Event {
+        Channel (char const* name, uint32_t size);
+        ~Channel () override;
+
+        auto next () -> Value override; // resume waiting tasks, if possible
+
+        //CG: wrap Channel send recv
+        auto send (Value msg) -> Value;
+        auto recv () -> Value;
+
+    private:
+        auto take () -> Value; // the next message, or nil if there is none
+
+        ChanRing* _ring;
     };
 
     //CG1 type <stacklet>
@@ -657,7 +785,34 @@ namespace monty {
             return __atomic_fetch_and(&pending, 0, __ATOMIC_RELAXED);
         }
 
-        static volatile uint32_t pending;
+        static ISOLATE volatile uint32_t pending;
+    };
+
+    // the run queue is a ring buffer, so that each context switch is O(1):
+    // tasks are pulled from the head, and added at either the head or the tail
+    struct RunQueue : Object, private Vector {
+        static Type info;
+        auto type () const -> Type const& override { return info; }
+        static Lookup const attrs;
+
+        //CG: wrap RunQueue append
+        auto append (Value) -> Value; // at the tail, i.e. run it last
+        void push (Value); // at the head, i.e. run it next
+        auto pull () -> Value; // from the head, nil if there is none
+
+        auto len () const -> uint32_t override { return _count; }
+        auto at (uint32_t i) const -> Value { return (*this)[wrap(_head + i)]; }
+        auto contains (Value) const -> bool;
+
+        void marker () const override { markVec(*this); }
+    private:
+        auto wrap (uint32_t i) const -> uint32_t {
+            return i < cap() ? i : i - cap();
+        }
+        void grow ();
+
+        uint32_t _head = 0;
+        uint32_t _count = 0;
     };
 
     //CG1 type <context>
@@ -665,25 +820,59 @@ namespace monty {
         void repr (Buffer& buf) const override { Object::repr(buf); }
 
         auto iter () const -> Value override { return this; }
+        auto asTask () -> Context* override { return this; }
 
         void resumeCaller (Value v ={});
 
         void marker () const override;
 
         Context* _caller =nullptr;
-        Value _transfer; // set to deadline while suspended
+        Value _transfer; // passed back in when resumed
+        bool _arena =false; // allocate in an arena, released when done
+        uint32_t _timer =0; // 1 + position in Event::timers, 0 if none
 
         static auto runLoop () -> bool;
 
         virtual auto run () -> bool =0;
         virtual void raise (Value);
+        virtual auto nested (Value f, ArgVec const& args, Value& res) -> bool;
+        // the code object and offset which is running, if known
+        virtual auto allocSite (uint32_t&) const -> Object const* {
+            return nullptr;
+        }
         //virtual void timedOut (Event&) {}
 
         static void exception (Value); // a safe way to current->raise()
+        // a call which must finish before returning, even if it runs bytecode,
+        // false if it raised: then res is that exception, which stays pending
+        static auto callNow (Value f, ArgVec const& args, Value& res) -> bool;
         static void gcAll ();
+        static void gcMinor ();
+        static auto gcStep (uint32_t budget) -> bool;
+
+        static ISOLATE uint32_t gcSlice; // incr. gc budget, 0 = stop-the-world
+
+        static ISOLATE RunQueue ready;
+        static ISOLATE Context* current;
+    };
 
-        static List ready;
-        static Context* current;
+    // heap profiler: tallies the heap per type and, when tracking is enabled,
+    // all allocations per code location - these are diagnostic tools, not fast
+    struct HeapProf {
+        static void track (bool on); // also clears all site counts
+        static auto types () -> Value; // {name: [count, obj bytes, vec bytes]}
+        static auto sites () -> Value; // [[file, func, line, count, bytes]]
+        static void dump (Buffer&); // a text snapshot of both, one per line
+        static void marker (); // keeps the tracked code objects alive
+    };
+
+    // heap image: a copy of both pools, the loaded modules, and the qstrs, to
+    // load at startup instead of importing everything again (same build only)
+    // saving starts with a full gc, and fails if there's no room for a bitmap,
+    // or if some object refers to data outside the heap, e.g. code run in place
+    struct HeapImage {
+        static auto save (void (*out) (void const*, uint32_t)) -> bool;
+        static auto load (void const*) -> bool; // only right after init
     };
 
     //CG1 type <module>
@@ -698,8 +887,8 @@ namespace monty {
             return v.isNil() && name == Q(0,"__name__") ? _name : v;
         }
 
-        static Dict builtins;
-        static Dict loaded;
+        static ISOLATE Dict builtins;
+        static ISOLATE Dict loaded;
 
         Value _name;
     };
@@ -786,6 +975,10 @@ namespace monty {
         static Lookup const bases; // this maps the derivation hierarchy
         static auto findId (Function const&) -> int; // find in builtinsMap
         static Lookup const attrs;
+
+        auto operator new (size_t bytes) -> void* { return cache.take(bytes); }
+        void operator delete (void* p, size_t bytes) { cache.give(p, bytes); }
+        static ISOLATE Recycler cache;
     private:
         Exception (E exc, ArgVec const& args);
         ~Exception () override { adj(0); } // needs explicit cleanup
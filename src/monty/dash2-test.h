@@ -126,3 +126,181 @@ TEST_CASE("type") {
     Vec::compact();
     //FIXME CHECK(memAvail == gcMax());
 }
+
+static auto sorted (Vector const& v, bool rev =false) -> bool {
+    for (uint32_t i = 1; i < v.size(); ++i)
+        if (rev ? v[i-1].binOp(BinOp::Less, v[i]).truthy()
+                : v[i].binOp(BinOp::Less, v[i-1]).truthy())
+            return false;
+    return true;
+}
+
+TEST_CASE("sort") {
+    static uint8_t memory [128*1024];
+    gcSetup(memory, sizeof memory);
+
+    List l;
+    uint32_t seed = 1;
+    auto random = [&]() { seed = seed * 1103515245 + 12345; return seed >> 8; };
+
+    SUBCASE("empty and single") {
+        CHECK(sortVec(l).isNil());
+        l.append(42);
+        CHECK(sortVec(l).isNil());
+        CHECK(42 == l[0]);
+    }
+
+    SUBCASE("small ints") {
+        for (int i = 0; i < 3000; ++i)
+            l.append((int) (random() % 2000) - 1000);
+        sortVec(l);
+        CHECK(3000 == l.size());
+        CHECK(sorted(l));
+        sortVec(l, {}, true);
+        CHECK(sorted(l, true));
+    }
+
+    SUBCASE("sorted and reversed input") {
+        for (int i = 0; i < 1000; ++i)
+            l.append(i);
+        sortVec(l);
+        CHECK(sorted(l));
+        sortVec(l, {}, true);
+        CHECK(sorted(l, true));
+        CHECK(999 == l[0]);
+        sortVec(l);
+        CHECK(0 == l[0]);
+        CHECK(999 == l[999]);
+    }
+
+    SUBCASE("all equal") {
+        for (int i = 0; i < 1000; ++i)
+            l.append(7);
+        sortVec(l);
+        CHECK(sorted(l));
+    }
+
+    SUBCASE("qstrs") {
+        static char const* words [] = { "print", "abs", "list", "dict", "len" };
+        for (auto e : words) {
+            Value v = e;
+            CHECK(v.isQid());
+            l.append(v);
+        }
+        sortVec(l);
+        CHECK("abs" == (char const*) l[0]);
+        CHECK("dict" == (char const*) l[1]);
+        CHECK("len" == (char const*) l[2]);
+        CHECK("list" == (char const*) l[3]);
+        CHECK("print" == (char const*) l[4]);
+    }
+
+    SUBCASE("big ints") {
+        for (int i = 0; i < 1000; ++i)
+            l.append(Int::make(((int64_t) 1 << 40) + random() % 500));
+        sortVec(l);
+        CHECK(sorted(l));
+    }
+
+    SUBCASE("stable strings") {
+        // same text at different addresses, i.e. equal but not identical
+        static char const s1 [] = "zz", s2 [] = "zz", s3 [] = "zz";
+        Value v1 = s1, v2 = s2, v3 = s3;
+        CHECK(!v1.isQid());
+        l.append(v2); l.append("b"); l.append(v1); l.append("a"); l.append(v3);
+        sortVec(l);
+        CHECK("a" == (char const*) l[0]);
+        CHECK("b" == (char const*) l[1]);
+        CHECK(v2.id() == l[2].id());
+        CHECK(v1.id() == l[3].id());
+        CHECK(v3.id() == l[4].id());
+        sortVec(l, {}, true);
+        CHECK(v2.id() == l[0].id());
+        CHECK(v1.id() == l[1].id());
+        CHECK(v3.id() == l[2].id());
+        CHECK("a" == (char const*) l[4]);
+    }
+
+    SUBCASE("stable key") {
+        static Function const bucket ([](ArgVec const& args) -> Value {
+            return (int) args[0] / 100;
+        });
+        for (int i = 0; i < 2000; ++i)
+            l.append((int) (random() % 1000) * 2000 + i); // i makes them unique
+        sortVec(l, bucket);
+        for (uint32_t i = 1; i < l.size(); ++i) {
+            int a = l[i-1], b = l[i];
+            CHECK(a / 100 <= b / 100);
+            if (a / 100 == b / 100)
+                CHECK(a % 2000 < b % 2000); // original order is kept
+        }
+        sortVec(l, bucket, true);
+        for (uint32_t i = 1; i < l.size(); ++i) {
+            int a = l[i-1], b = l[i];
+            CHECK(a / 100 >= b / 100);
+            if (a / 100 == b / 100)
+                CHECK(a % 2000 < b % 2000); // also kept in reverse
+        }
+    }
+
+    l.clear();
+    Object::sweep();
+    Vec::compact();
+}
+
+TEST_CASE("tuple") {
+    static uint8_t memory [64*1024];
+    gcSetup(memory, sizeof memory);
+
+    Value args [] = {1, "abc", 3};
+
+    SUBCASE("inline") {
+        Value v = Tuple::make({args});
+        auto& t = v.asType<Tuple>();
+        CHECK(3 == t.size());
+        CHECK(Obj::inPool(&t));
+        CHECK(!Vec::inPool(t.begin()));
+        CHECK((void*) (&t + 1) == (void*) t.begin());
+        CHECK(1 == t[0]);
+        CHECK("abc" == (char const*) t[1]);
+        CHECK(3 == t[2]);
+        CHECK(!t.adj(10)); // can't grow
+    }
+
+    SUBCASE("empty and large") {
+        CHECK(Empty.id() == Tuple::make({}).id());
+
+        Value big [Tuple::inlineMax+1];
+        for (auto& e : big)
+            e = 0;
+        auto& t = Tuple::make({big}).asType<Tuple>();
+        CHECK(Tuple::inlineMax+1 == t.size());
+        CHECK(Vec::inPool(t.begin()));
+    }
+
+    SUBCASE("memory use") {
+        constexpr int N = 200;
+
+        auto o0 = gcMax();
+        auto v0 = (uintptr_t) vecHigh;
+        for (int i = 0; i < N; ++i)
+            new Tuple ({args});
+        auto o1 = gcMax();
+        auto v1 = (uintptr_t) vecHigh;
+        for (int i = 0; i < N; ++i)
+            Tuple::make({args});
+        auto o2 = gcMax();
+        auto v2 = (uintptr_t) vecHigh;
+
+        auto separate = (o0 - o1) + (v1 - v0);
+        auto combined = (o1 - o2) + (v2 - v1);
+        MESSAGE("3-tuple bytes: separate ", separate / N,
+                ", inline ", combined / N);
+        CHECK(v1 > v0);
+        CHECK(v2 == v1);
+        CHECK(combined < separate);
+    }
+
+    Object::sweep();
+    Vec::compact();
+}
@@ -308,6 +308,12 @@ auto Str::binop (BinOp op, Value rhs) const -> Value {
     switch (op) {
         case BinOp::Equal:
             return rhs == *this;
+        case BinOp::Less: {
+            if (!rhs.isStr() && rhs.ifType<Str>() == nullptr)
+                return {E::TypeError, "can't order", rhs};
+            char const* r = rhs.isStr() ? rhs : rhs.asType<Str>();
+            return Value::asBool(strcmp(*this, r) < 0);
+        }
         case BinOp::Add: {
             auto l = (char const*) begin();
             char const* r = rhs.isStr() ? rhs : rhs.asType<Str>();
@@ -430,6 +436,23 @@ Tuple::Tuple (ArgVec const& args) {
         (*this)[i] = args[i];
 }
 
+// the items live in the same allocation, just past the end of this object,
+// the vector is not in the vec pool, so it can't be resized (nor compacted)
+Tuple::Tuple (Inline, ArgVec const& args)
+        : Vector ((Value const*) (this + 1), args.size()) {
+    for (int i = 0; i < args.size(); ++i)
+        (*this)[i] = args[i];
+}
+
+auto Tuple::make (ArgVec const& args) -> Value {
+    uint32_t n = args.size();
+    if (n == 0)
+        return Empty;
+    if (n > inlineMax)
+        return new Tuple (args);
+    return new (n * sizeof (Value)) Tuple (Inline {}, args);
+}
+
 auto Tuple::getAt (Value k) const -> Value {
     if (!k.isInt())
         return sliceGetter(k);
@@ -479,6 +502,7 @@ auto List::pop (int idx) -> Value {
 }
 
 auto List::append (Value v) -> Value {
+    remember(*this);
     Vector::append(v);
     return {};
 }
@@ -488,6 +512,7 @@ auto List::setAt (Value k, Value v) -> Value {
         return sliceSetter(k, v);
     auto n = relPos(k);
     assert(n < size());
+    remember(*this);
     return (*this)[n] = v;
 }
 
@@ -499,6 +524,7 @@ auto List::store (Range const& r, Object const& v) -> Value {
         remove(r._from + nlen, olen - nlen);
     else if (nlen > olen)
         insert(r._from + olen, nlen - olen);
+    remember(*this);
     for (int i = 0; i < nlen; ++i)
         (*this)[r.getAt(i)] = v.getAt(i);
     return {};
@@ -513,6 +539,357 @@ void List::repr (Buffer& buf) const {
     printer(buf, "[]");
 }
 
+auto List::sort (ArgVec const& args) -> Value {
+    //CG: kwargs key reverse
+    return sortVec(*this, key, reverse.isOk() && reverse.truthy());
+}
+
+// In-place sorting of a vector's own storage. Lists with only small ints or
+// only qstrs use an unstable pattern-defeating quicksort, which is fine since
+// equal items have identical bits there. Everything else, and all sorts with a
+// key function, use a stable merge sort which rotates items instead of using
+// a temporary buffer. The only allocation is the key cache, when key= is set.
+// Key functions run to completion right away, even in bytecode. Ints and strs
+// can be ordered, but not a mix of them, nor any other types.
+
+static void swapVals (Value& a, Value& b) {
+    auto t = a; a = b; b = t;
+}
+
+static auto lessInt (Value a, Value b) -> bool {
+    return (intptr_t) a.id() < (intptr_t) b.id(); // tagged bits, same order
+}
+
+static auto lessQid (Value a, Value b) -> bool {
+    return a.id() != b.id() && strcmp(a, b) < 0;
+}
+
+static auto lessAny (Value a, Value b) -> bool {
+    if (a.isInt() && b.isInt())
+        return lessInt(a, b);
+    if (a.isStr() && b.isStr())
+        return strcmp(a, b) < 0;
+    return a.binOp(BinOp::Less, b).truthy();
+}
+
+// only ints and strs can be ordered, and only amongst themselves
+static auto orderOf (Value v) -> int {
+    if (v.isInt() || v.ifType<Int>() != nullptr)
+        return 1;
+    if (v.isStr() || v.ifType<Str>() != nullptr)
+        return 2;
+    return 0;
+}
+
+template< typename L >
+static void insertionSort (Value* lo, Value* hi, L less) {
+    for (auto p = lo + 1; p < hi; ++p) {
+        auto v = *p;
+        auto q = p;
+        for (; q > lo && less(v, q[-1]); --q)
+            *q = q[-1];
+        *q = v;
+    }
+}
+
+// same as insertionSort, but give up when it's clearly not almost sorted
+template< typename L >
+static auto partialInsertionSort (Value* lo, Value* hi, L less) -> bool {
+    uint32_t moves = 0;
+    for (auto p = lo + 1; p < hi; ++p) {
+        auto v = *p;
+        auto q = p;
+        for (; q > lo && less(v, q[-1]); --q)
+            *q = q[-1];
+        *q = v;
+        moves += p - q;
+        if (moves > 8)
+            return false;
+    }
+    return true;
+}
+
+template< typename L >
+static void siftDown (Value* a, uint32_t i, uint32_t n, L less) {
+    auto v = a[i];
+    for (auto c = 2*i + 1; c < n; c = 2*i + 1) {
+        if (c + 1 < n && less(a[c], a[c+1]))
+            ++c;
+        if (!less(v, a[c]))
+            break;
+        a[i] = a[c];
+        i = c;
+    }
+    a[i] = v;
+}
+
+template< typename L >
+static void heapSort (Value* lo, Value* hi, L less) {
+    uint32_t n = hi - lo;
+    for (auto i = n / 2; i-- > 0; )
+        siftDown(lo, i, n, less);
+    while (--n > 0) {
+        swapVals(lo[0], lo[n]);
+        siftDown(lo, 0, n, less);
+    }
+}
+
+// order three items, the median is then used as pivot
+template< typename L >
+static void sort3 (Value* a, Value* b, Value* c, L less) {
+    if (less(*b, *a))
+        swapVals(*a, *b);
+    if (less(*c, *b)) {
+        swapVals(*b, *c);
+        if (less(*b, *a))
+            swapVals(*a, *b);
+    }
+}
+
+// partition around *lo, returns where the pivot ends up, sets done if no
+// items had to be swapped, i.e. if the range was already partitioned
+template< typename L >
+static auto partition (Value* lo, Value* hi, bool& done, L less) -> Value* {
+    auto pivot = *lo;
+    auto first = lo, last = hi;
+    while (less(*++first, pivot)) {}
+    if (first - 1 == lo)
+        while (first < last && !less(*--last, pivot)) {}
+    else
+        while (!less(*--last, pivot)) {}
+    done = first >= last;
+    while (first < last) {
+        swapVals(*first, *last);
+        while (less(*++first, pivot)) {}
+        while (!less(*--last, pivot)) {}
+    }
+    *lo = first[-1];
+    first[-1] = pivot;
+    return first - 1;
+}
+
+// see https://github.com/orlp/pdqsort - with heapsort as final fallback
+template< typename L >
+static void pdqSort (Value* lo, Value* hi, int bad, L less) {
+    constexpr uint32_t SMALL = 24;
+    while (true) {
+        uint32_t n = hi - lo;
+        if (n < SMALL)
+            return insertionSort(lo, hi, less);
+
+        sort3(lo + n/2, lo, hi - 1, less);
+        bool done;
+        auto p = partition(lo, hi, done, less);
+        uint32_t nl = p - lo, nr = hi - (p + 1);
+
+        if (nl < n/8 || nr < n/8) { // very unbalanced, break up patterns
+            if (--bad <= 0)
+                return heapSort(lo, hi, less);
+            if (nl >= SMALL) {
+                swapVals(lo[0], lo[nl/4]);
+                swapVals(p[-1], p[-(int) nl/4]);
+            }
+            if (nr >= SMALL) {
+                swapVals(p[1], p[1+nr/4]);
+                swapVals(hi[-1], hi[-(int) nr/4]);
+            }
+        } else if (done && partialInsertionSort(lo, p, less)
+                        && partialInsertionSort(p + 1, hi, less))
+            return; // both sides were already (nearly) in order
+
+        // recurse into the smaller side, iterate on the larger one
+        if (nl < nr) {
+            pdqSort(lo, p, bad, less);
+            lo = p + 1;
+        } else {
+            pdqSort(p + 1, hi, bad, less);
+            hi = p;
+        }
+    }
+}
+
+// see Go's sort.Stable: insertion sort on small blocks + in-place SymMerge
+struct StableSort {
+    Value* _keys;
+    Value* _vals; // moved in lockstep with the keys, unless null
+
+    auto less (uint32_t i, uint32_t j) const { return lessAny(_keys[i], _keys[j]); }
+
+    void swap (uint32_t i, uint32_t j) {
+        swapVals(_keys[i], _keys[j]);
+        if (_vals != nullptr)
+            swapVals(_vals[i], _vals[j]);
+    }
+
+    void swapRange (uint32_t a, uint32_t b, uint32_t n) {
+        for (uint32_t i = 0; i < n; ++i)
+            swap(a + i, b + i);
+    }
+
+    void rotate (uint32_t a, uint32_t m, uint32_t b) {
+        auto i = m - a, j = b - m;
+        while (i != j)
+            if (i > j) {
+                swapRange(m - i, m, j);
+                i -= j;
+            } else {
+                swapRange(m - i, m + j - i, i);
+                j -= i;
+            }
+        swapRange(m - i, m, i);
+    }
+
+    void insertion (uint32_t a, uint32_t b) {
+        for (auto i = a + 1; i < b; ++i)
+            for (auto j = i; j > a && less(j, j - 1); --j)
+                swap(j, j - 1);
+    }
+
+    void symMerge (uint32_t a, uint32_t m, uint32_t b) {
+        if (m - a == 1) { // binary insert of a single item on the left
+            auto i = m, j = b;
+            while (i < j) {
+                auto h = (i + j) / 2;
+                if (less(h, a))
+                    i = h + 1;
+                else
+                    j = h;
+            }
+            for (auto k = a; k + 1 < i; ++k)
+                swap(k, k + 1);
+            return;
+        }
+        if (b - m == 1) { // binary insert of a single item on the right
+            auto i = a, j = m;
+            while (i < j) {
+                auto h = (i + j) / 2;
+                if (!less(m, h))
+                    i = h + 1;
+                else
+                    j = h;
+            }
+            for (auto k = m; k > i; --k)
+                swap(k, k - 1);
+            return;
+        }
+
+        auto mid = (a + b) / 2, n = mid + m;
+        uint32_t start, r;
+        if (m > mid) {
+            start = n - b;
+            r = mid;
+        } else {
+            start = a;
+            r = m;
+        }
+        auto p = n - 1;
+        while (start < r) {
+            auto c = (start + r) / 2;
+            if (!less(p - c, c))
+                start = c + 1;
+            else
+                r = c;
+        }
+
+        auto end = n - start;
+        if (start < m && m < end)
+            rotate(start, m, end);
+        if (a < start && start < mid)
+            symMerge(a, start, mid);
+        if (mid < end && end < b)
+            symMerge(mid, end, b);
+    }
+
+    void sort (uint32_t n) {
+        constexpr uint32_t BLOCK = 20;
+        uint32_t a = 0;
+        for (; a + BLOCK <= n; a += BLOCK)
+            insertion(a, a + BLOCK);
+        insertion(a, n);
+
+        for (auto bs = BLOCK; bs < n; bs *= 2) {
+            a = 0;
+            for (; a + 2*bs <= n; a += 2*bs)
+                symMerge(a, a + bs, a + 2*bs);
+            if (a + bs < n)
+                symMerge(a, a + bs, n);
+        }
+    }
+};
+
+static void reverseVec (Value* p, uint32_t n) {
+    for (uint32_t i = 0; i < n / 2; ++i)
+        swapVals(p[i], p[n-1-i]);
+}
+
+auto monty::sortVec (Vector& vec, Value key, bool rev) -> Value {
+    uint32_t n = vec.size();
+    if (n < 2)
+        return {};
+    auto vals = vec.begin();
+
+    if (key.isNil() || key.isNone()) {
+        bool allInts = true, allQids = true;
+        for (auto e : vec) {
+            allInts = allInts && e.isInt();
+            allQids = allQids && e.isQid();
+        }
+        if (allInts || allQids) {
+            int bad = 0; // allow log2(n) unbalanced partitions
+            for (auto i = n; i > 1; i >>= 1)
+                ++bad;
+            if (allInts)
+                pdqSort(vals, vals + n, bad, lessInt);
+            else
+                pdqSort(vals, vals + n, bad, lessQid);
+            if (rev)
+                reverseVec(vals, n);
+            return {};
+        }
+        key = {};
+    }
+
+    // each key call finds its callee in the slot before its arg, as on a VM
+    // stack, and the key then replaces it: the last slot is only for args
+    Vector keys;
+    if (key.isOk()) {
+        keys.insert(0, n + 1);
+        for (uint32_t i = 0; i < n; ++i) {
+            keys[i] = key;
+            keys[i+1] = vec[i];
+            Value k;
+            if (!Context::callNow(key, {keys, 1, (int) i + 1}, k))
+                return k; // stop at the first exception
+            keys[i] = k;
+        }
+        keys.remove(n);
+        if (vec.size() != n)
+            return {E::ValueError, "list modified during sort"};
+        vals = vec.begin(); // the key calls may have moved it
+    }
+
+    auto first = keys.size() > 0 ? keys.begin() : vals;
+    auto order = orderOf(first[0]);
+    for (uint32_t i = 0; i < n; ++i)
+        if (order == 0 || orderOf(first[i]) != order)
+            return {E::TypeError, "can't order", first[i]};
+
+    // with reverse, stability requires: reverse, sort, and reverse again
+    StableSort ss {first, keys.size() > 0 ? vals : nullptr};
+    if (rev) {
+        reverseVec(vals, n);
+        if (ss._vals != nullptr)
+            reverseVec(ss._keys, n);
+    }
+    ss.sort(n);
+    if (rev) {
+        reverseVec(vals, n);
+        if (ss._vals != nullptr)
+            reverseVec(ss._keys, n);
+    }
+    return {};
+}
+
 auto Set::find (Value v) const -> uint32_t {
     for (auto& e : *this)
         if (v == e)
@@ -526,6 +903,7 @@ auto Set::Proxy::operator= (bool f) -> bool {
     if (pos < n && !f)
         s.remove(pos);
     else if (pos == n && f) {
+        remember(s);
         s.insert(pos);
         s[pos] = v;
     }
@@ -556,24 +934,8 @@ void Set::repr (Buffer& buf) const {
     printer(buf, "{}");
 }
 
-// was: CG3 type <dictview>
-struct DictView : Object {
-    static Type info;
-    auto type () const -> Type const& override { return info; }
-
-    DictView (Dict const& dict, int vtype) : _dict (dict), _vtype (vtype) {}
-
-    auto len () const -> uint32_t override { return _dict._fill; }
-    auto getAt (Value k) const -> Value override;
-    auto iter () const -> Value override { return 0; }
-
-    void marker () const override { _dict.marker(); }
-private:
-    Dict const& _dict;
-    int _vtype;
-};
-
 Type DictView::info (Q(0,"<dictview>"));
+ISOLATE Recycler DictView::cache (sizeof (DictView));
 
 // dict invariant: items layout is: N keys, then N values, with N == d.size()
 auto Dict::Proxy::operator= (Value v) -> Value {
@@ -588,6 +950,7 @@ auto Dict::Proxy::operator= (Value v) -> Value {
             d._fill = --n;    // set length to new key count
         }
     } else {
+        remember(d);
         if (pos == n) { // move all values up and create new gaps
             d._fill = 2*n;    // don't wipe existing vals
             d.insert(2*n);    // create slot for new value
@@ -659,7 +1022,7 @@ auto DictView::getAt (Value k) const -> Value {
     if (_vtype <= 1)
         return _dict[n];
     Value args [] = {_dict[n], _dict[n+_dict._fill]};
-    return new Tuple ({args});
+    return Tuple::make({args});
 }
 
 auto Type::noFactory (ArgVec const&, const Type*) -> Value {
@@ -688,7 +1051,7 @@ Class::Class (ArgVec const& args) : Type (args[1], nullptr, Inst::create) {
         _chain = &args[2].asType<Class>();
 
     at(Q(0,"__name__")) = args[1];
-    at(Q(0,"__bases__")) = new Tuple ({args._vec, args.size()-2, args._off+2});
+    at(Q(0,"__bases__")) = Tuple::make({args._vec, args.size()-2, args._off+2});
 
     args[0]->call({args._vec, args.size() - 2, args._off + 2});
 }
@@ -72,6 +72,14 @@ static auto f_len (Value arg) -> Value {
     return arg.isStr() ? strlen(arg) : arg->len();
 }
 
+//CG1 bind sorted arg *
+static auto f_sorted (ArgVec const& args, Value arg) -> Value {
+    //CG: kwargs key reverse
+    auto r = new List (arg);
+    auto v = sortVec(*r, key, reverse.isOk() && reverse.truthy());
+    return v.isNil() ? r : v;
+}
+
 //CG1 bind abs arg
 static auto f_abs (Value arg) -> Value {
     return arg.unOp(UnOp::Abso);
@@ -122,6 +130,7 @@ static Lookup::Item const exceptionMap [] = {
 };
 
 Lookup const Exception::bases (exceptionMap);
+ISOLATE Recycler Exception::cache (sizeof (Exception));
 
 //CG: wrappers *
 
@@ -133,7 +142,7 @@ static Lookup::Item const builtinsMap [] = {
 };
 
 static Lookup const builtins_attrs (builtinsMap);
-Dict Module::builtins (&builtins_attrs);
+ISOLATE Dict Module::builtins (&builtins_attrs);
 
 Exception::Exception (E code, ArgVec const& args) : Tuple (args), _code (code) {
     adj(_fill+1);
@@ -180,6 +189,7 @@ struct SizeFix {
 
 void Exception::addTrace (uint32_t off, Value bc) {
     SizeFix fixer (*this);
+    remember(*this);
     append(off);
     append(bc);
 }
@@ -9,6 +9,7 @@
 
 #include <cassert>
 #include <csetjmp>
+#include <cstdlib>
 
 #if xNATIVE //FIXME
 extern void timerHook ();
@@ -19,14 +20,21 @@ extern void timerHook ();
 
 using namespace monty;
 
-List Context::ready;
-uint32_t volatile Stacklet::pending;
-Context* Context::current;
+ISOLATE RunQueue Context::ready;
+ISOLATE uint32_t volatile Stacklet::pending;
+ISOLATE Context* Context::current;
 
-int Event::queued;
-Vector Event::triggers;
+ISOLATE int Event::queued;
+ISOLATE Vector Event::triggers;
+ISOLATE Vector Event::timers;
+ISOLATE VecOf<uint32_t> Event::dues;
+auto (*Event::clock) () -> uint32_t;
 
-static jmp_buf* resumer;
+static ISOLATE jmp_buf* resumer;
+
+ISOLATE uint32_t Context::gcSlice;
+static ISOLATE int gcPhase; // 0 = idle, 1 = mark, 2 = sweep, 3 = compact
+static ISOLATE Context* arenaTask; // the task which opened the current arena
 
 #if 0
 struct Stacker : boss::Device {
@@ -39,7 +47,7 @@ struct Stacker : boss::Device {
 Stacker stacker;
 #endif
 
-void Context::gcAll () {
+static void markRoots () {
     // careful to avoid infinite recursion: the "sys" module has "modules" as
     // one of its attributes, which is "Module::loaded", i.e. a dict which
     // chains to the built-in modules (see "qstr.cpp"), which includes "sys",
@@ -53,15 +61,451 @@ void Context::gcAll () {
     Module::loaded._chain = nullptr;
 
     markVec(Event::triggers);
-    mark(current);
-    ready.marker();
+    markVec(Event::timers);
+    HeapProf::marker();
+    Recycler::markAll();
+    mark(arenaTask);
+    mark(Context::current);
+    Context::ready.marker();
     save->marker();
 
     // restore the broken chain, now that marking is complete
     Module::loaded._chain = save;
+}
 
+// running tasks modify their stack without a write barrier, see gcMinor
+static void markTasks () {
+    if (Context::current != nullptr)
+        Context::current->marker();
+    for (uint32_t i = 0; i < Context::ready.len(); ++i)
+        Context::ready.at(i)->marker();
+}
+
+void Context::gcAll () {
+    while (gcPhase != 0) // first finish an incremental gc, if there is one
+        gcStep(~0U);
+    Recycler::clearAll(); // the kept slots become garbage
+    markRoots();
     sweep();
-    compact();
+    if (vecCheck())
+        compact();
+}
+
+// An incremental gc spreads its work over multiple steps, each one bounded by
+// the budget (in bytes). Roots are not covered by the write barrier, so they
+// are marked once more at the end, and the remaining gray objects are traced
+// in the same step: only this final step's duration depends on the mutator.
+// Runnable tasks are traced again as well, since their stack and _transfer
+// slot may have changed after they turned black.
+auto Context::gcStep (uint32_t budget) -> bool {
+    switch (gcPhase) {
+        case 0:
+            Recycler::clearAll();
+            markStart();
+            markRoots();
+            gcPhase = 1;
+            break;
+        case 1:
+            if (markStep(budget)) {
+                markTasks();
+                markRoots();
+                markFinish();
+                sweepStart();
+                gcPhase = 2;
+            }
+            break;
+        case 2:
+            if (sweepStep(budget)) {
+                if (!vecCheck()) { // not fragmented enough to compact
+                    gcPhase = 0;
+                    return true;
+                }
+                gcPhase = 3;
+            }
+            break;
+        case 3:
+            if (compactStep(budget)) {
+                gcPhase = 0;
+                return true;
+            }
+    }
+    return false;
+}
+
+// A minor gc only reclaims objects allocated since the previous collection.
+// Old objects are not traced, except the ones which have been remembered, see
+// the write barrier in objs.cpp - running tasks modify their stack without a
+// barrier, so they are remembered when resumed, and traced here when ready.
+void Context::gcMinor () {
+    if (gcPhase != 0 || !minorStart()) {
+        // the occasional full gc: in steps, unless allocation outpaces it
+        if (gcSlice == 0)
+            gcAll();
+        else if (gcPhase != 0 && gcCheck())
+            while (!gcStep(~0U)) {}
+        else
+            gcStep(gcSlice);
+        return;
+    }
+    markTasks();
+    markRoots();
+    minorSweep();
+}
+
+// An arena task gets all the objects it allocates in an arena, which is then
+// released when the task is done, in the same way as a minor gc. Only one
+// arena can be open, so other arena tasks started meanwhile don't get one.
+// The arena is held while any other code runs, so its objects stay out of it.
+static void releaseArena () {
+    arenaTask = nullptr;
+    if (gcPhase != 0 || !Obj::arenaStart())
+        return;
+    markTasks();
+    markRoots();
+    Obj::arenaSweep();
+}
+
+// The heap profiler walks both pools to attribute objects and vectors to their
+// type. Vectors are attributed to the object they're in, which takes a search
+// through the object pool for each one, but this is only done on request.
+// Site tracking hooks into each allocation, and asks the current context where
+// it is, i.e. which code object and offset (only a PyVM context can tell).
+// Both tables are fixed-size, their last entry collects everything which did
+// not fit, and is reported as "?", just like vectors not inside an object.
+
+struct HeapTally {
+    struct Entry {
+        Object const* key; // type or code object
+        uint32_t off, count, bytes, vecBytes;
+    };
+
+    static constexpr auto SIZE = 32;
+    Entry entries [SIZE];
+    int fill;
+
+    auto find (Object const* key, uint32_t off =0) -> Entry& {
+        for (int i = 0; i < fill; ++i)
+            if (entries[i].key == key && entries[i].off == off)
+                return entries[i];
+        if (fill >= SIZE - 1)
+            return entries[SIZE-1];
+        auto& e = entries[fill++];
+        e.key = key;
+        e.off = off;
+        return e;
+    }
+
+    void clear () { memset(this, 0, sizeof *this); }
+
+    auto begin () -> Entry* { return entries; }
+    auto end () -> Entry* { return entries + SIZE; }
+};
+
+static ISOLATE HeapTally typeTally, siteTally;
+
+static void siteHook (uint32_t bytes) {
+    uint32_t off = 0;
+    auto ctx = Context::current;
+    auto& e = siteTally.find(ctx != nullptr ? ctx->allocSite(off) : nullptr, off);
+    ++e.count;
+    e.bytes += bytes;
+}
+
+static void tallyObj (Obj const& obj, uint32_t bytes) {
+    auto& e = typeTally.find(&((Object const&) obj).type());
+    ++e.count;
+    e.bytes += bytes;
+}
+
+static void tallyVec (Vec const& vec, uint32_t bytes) {
+    auto p = Obj::findOwner(&vec);
+    auto t = p != nullptr ? &((Object const*) p)->type() : nullptr;
+    typeTally.find(t).vecBytes += bytes;
+}
+
+static void tallyTypes () {
+    typeTally.clear();
+    Obj::walk(tallyObj);
+    Vec::walk(tallyVec);
+}
+
+static auto typeName (HeapTally::Entry const& e) -> char const* {
+    return e.key != nullptr ? (char const*) ((Type const*) e.key)->_name : "?";
+}
+
+void HeapProf::track (bool on) {
+    siteTally.clear();
+    allocHook = on ? siteHook : nullptr;
+}
+
+auto HeapProf::types () -> Value {
+    tallyTypes();
+    auto r = new Dict;
+    for (auto& e : typeTally)
+        if (e.count > 0 || e.vecBytes > 0) {
+            auto v = new List;
+            v->append(e.count);
+            v->append(e.bytes);
+            v->append(e.vecBytes);
+            r->at(typeName(e)) = v;
+        }
+    return r;
+}
+
+auto HeapProf::sites () -> Value {
+    auto r = new List;
+    for (auto& e : siteTally)
+        if (e.count > 0) {
+            auto v = new List;
+            if (e.key != nullptr) {
+                v->append(e.key->getAt(-1)); // file
+                v->append(e.key->getAt(-2)); // function
+                v->append(e.key->getAt(e.off)); // line
+            } else
+                for (int i = 0; i < 3; ++i)
+                    v->append("?");
+            v->append(e.count);
+            v->append(e.bytes);
+            r->append(v);
+        }
+    return r;
+}
+
+void HeapProf::dump (Buffer& buf) {
+    tallyTypes();
+    for (auto& e : typeTally)
+        if (e.count > 0 || e.vecBytes > 0)
+            buf.print("type %s %d %d %d\n",
+                        typeName(e), e.count, e.bytes, e.vecBytes);
+    for (auto& e : siteTally)
+        if (e.count > 0) {
+            if (e.key != nullptr)
+                buf.print("site %s %s %d", (char const*) e.key->getAt(-1),
+                            (char const*) e.key->getAt(-2),
+                            (int) e.key->getAt(e.off));
+            else
+                buf.print("site ? ? 0");
+            buf.print(" %d %d\n", e.count, e.bytes);
+        }
+}
+
+void HeapProf::marker () {
+    for (auto& e : siteTally)
+        if (e.count > 0)
+            mark(e.key);
+}
+
+// A heap image has both pools as is, and the static objects which refer to
+// them. Loading copies each part back, the object pool to the end of its new
+// pool, and the vector pool to the start of its new pool, then fixes up all
+// pointers: every word which points into one of the saved areas, either as is
+// or shifted as in string values, is moved by as much as that area has moved.
+// Raw data is left alone: the image ends with a bitmap, one bit per word of
+// the roots and both pools, in which the words reported by rawData() as well
+// as the qstrs added at run time are cleared. Pointers into the executable
+// only move if it's position-independent, which can only be handled when its
+// bounds are known (Linux). The static roots are per isolate, so they can
+// also move, as a whole. Vecs owned by other static objects are saved as free
+// space: these statics will not refer to them after loading. The same goes
+// for other statics which refer to objects: those objects are left as garbage.
+
+#if NATIVE && __linux__
+extern char __executable_start [], _end [];
+static auto const codeLow = (uintptr_t) __executable_start;
+static auto const codeHigh = (uintptr_t) _end;
+#else
+static uintptr_t const codeLow = 0, codeHigh = 0;
+#endif
+
+struct ImageHead {
+    static constexpr uint32_t MAGIC = 0x324D4948; // "HIM2"
+
+    uint32_t magic, words;
+    uintptr_t anchor; // to find out how far the executable has moved
+    uintptr_t codeLow, codeHigh, objLow, objHigh, vecLow, vecHigh;
+    uintptr_t roots [3]; // where the static roots were
+};
+
+static ISOLATE struct { void* ptr; uint32_t bytes; } const imageRoots [] = {
+    { &Module::loaded, sizeof Module::loaded },
+    { &Module::builtins, sizeof Module::builtins },
+    { &qstrRamMap, sizeof qstrRamMap },
+};
+
+static auto isImageRoot (void const* p) -> bool {
+    for (auto& e : imageRoots)
+        if (e.ptr <= p && p < (uint8_t*) e.ptr + e.bytes)
+            return true;
+    return false;
+}
+
+static auto keepVec (Vec const& vec) -> bool {
+    return Obj::inPool(&vec) || isImageRoot(&vec);
+}
+
+// the saved spans: the roots, the object pool, and the vector pool
+static ISOLATE struct { uintptr_t low, high; } imageSpans [5];
+static ISOLATE uint8_t* imageBits;
+static ISOLATE bool imageForeign; // refers to data outside the image and code
+
+// clear the bits of all words which overlap raw data, if it's in the image
+static auto clearRaw (void const* ptr, uint32_t bytes) -> bool {
+    auto p = (uintptr_t) ptr;
+    uint32_t base = 0; // bit index of the first word in the span
+    for (auto& e : imageSpans) {
+        if (e.low <= p && p < e.high && bytes > 0) {
+            if (bytes > e.high - p)
+                bytes = e.high - p;
+            auto first = (p - e.low) / sizeof (void*);
+            auto last = (p + bytes - 1 - e.low) / sizeof (void*);
+            for (auto i = base + first; i <= base + last; ++i)
+                imageBits[i/8] &= ~(1 << i%8);
+            return true;
+        }
+        base += (e.high - e.low) / sizeof (void*);
+    }
+    return false;
+}
+
+static void rawObj (Obj const& obj, uint32_t bytes) {
+    uint32_t n = 0;
+    auto p = (uint8_t const*) ((Object const&) obj).rawData(n);
+    auto end = (uint8_t const*) &obj - sizeof (void*) + bytes; // slot end
+    if ((uint8_t const*) &obj <= p && p < end && n > end - p)
+        n = end - p; // inside the object, up to at most the end of its slot
+    if (n > 0 && !clearRaw(p, n) &&
+            (codeLow > (uintptr_t) p || (uintptr_t) p >= codeHigh))
+        imageForeign = true; // e.g. code executed in place, or a malloc'ed buf
+}
+
+auto HeapImage::save (void (*out) (void const*, uint32_t)) -> bool {
+    Context::gcAll();
+    Vec::compact();
+
+    void *low, *high;
+    objSpan(low, high);
+    for (int i = 0; i < 3; ++i)
+        imageSpans[i] = {(uintptr_t) imageRoots[i].ptr,
+                            (uintptr_t) imageRoots[i].ptr + imageRoots[i].bytes};
+    imageSpans[3] = {(uintptr_t) low, (uintptr_t) high};
+    imageSpans[4] = {(uintptr_t) vecLow, (uintptr_t) vecHigh};
+
+    uint32_t words = 0;
+    for (auto& e : imageSpans)
+        words += (e.high - e.low) / sizeof (void*);
+    uint32_t bitBytes = (words + 7) / 8;
+    imageBits = (uint8_t*) malloc(bitBytes);
+    if (imageBits == nullptr)
+        return false;
+    memset(imageBits, 0xFF, bitBytes);
+    imageForeign = false;
+    Obj::walk(rawObj);
+    clearRaw(qstrRamMap.first(), qstrRamMap.limit() - qstrRamMap.first());
+    if (imageForeign) {
+        free(imageBits);
+        imageBits = nullptr;
+        return false; // that data will not be there when the image is loaded
+    }
+
+    ImageHead head {ImageHead::MAGIC, sizeof (void*),
+                    (uintptr_t) &Object::info, codeLow, codeHigh,
+                    (uintptr_t) low, (uintptr_t) high,
+                    (uintptr_t) vecLow, (uintptr_t) vecHigh, {}};
+    for (int i = 0; i < 3; ++i)
+        head.roots[i] = (uintptr_t) imageRoots[i].ptr;
+    out(&head, sizeof head);
+
+    for (auto& e : imageRoots)
+        out(e.ptr, e.bytes);
+    out(low, (uint8_t*) high - (uint8_t*) low);
+    vecImage(out, keepVec);
+    out(imageBits, bitBytes);
+
+    free(imageBits);
+    imageBits = nullptr;
+    return true;
+}
+
+struct ImageArea {
+    uintptr_t low, high;
+    intptr_t move;
+};
+
+static ISOLATE ImageArea imageAreas [6]; // objs, vecs, executable, and roots
+static ISOLATE uint32_t imageNext; // bit index of the next word to fix
+
+static void fixWords (void* ptr, uint32_t bytes) {
+    auto p = (uintptr_t*) ptr;
+    for (uint32_t i = 0; i < bytes / sizeof *p; ++i, ++imageNext) {
+        if ((imageBits[imageNext/8] & (1 << imageNext%8)) == 0)
+            continue; // raw data
+        // only aligned words can point into the pools and roots, which also
+        // skips tagged ints, but text in the executable can be at any offset
+        auto w = p[i], s = w >> 2; // string values hold a shifted pointer
+        auto aligned = w % sizeof (void*) == 0;
+        for (auto& a : imageAreas)
+            if ((aligned || &a == imageAreas + 2) &&
+                    a.low <= w && w <= a.high) {
+                p[i] = w + a.move;
+                break;
+            } else if ((w & 3) == 2 && a.low <= s && s <= a.high) {
+                p[i] = w + 4 * a.move;
+                break;
+            }
+    }
+}
+
+auto HeapImage::load (void const* image) -> bool {
+    auto& head = *(ImageHead const*) image;
+    if (head.magic != ImageHead::MAGIC || head.words != sizeof (void*) ||
+            head.codeHigh - head.codeLow != codeHigh - codeLow)
+        return false; // not made by this build
+    intptr_t codeMove = (uintptr_t) &Object::info - head.anchor;
+    if (codeMove != 0 && head.codeLow == head.codeHigh)
+        return false; // the executable has moved, but its bounds are unknown
+
+    void *low, *high;
+    objSpan(low, high);
+    if ((uint8_t*) high - (uint8_t*) low > 2 * (int) sizeof (void*) ||
+            vecHigh != vecLow)
+        return false; // the pools must be empty
+    uint32_t objBytes = head.objHigh - head.objLow;
+    uint32_t vecBytes = head.vecHigh - head.vecLow;
+    if (!objReserve(objBytes) || !vecReserve(vecBytes))
+        return false; // and large enough, or able to grow
+    auto objDest = (uint8_t*) high - objBytes;
+    auto vecDest = (uint8_t*) vecLow;
+
+    imageAreas[0] = {head.objLow, head.objHigh,
+                        (intptr_t) objDest - (intptr_t) head.objLow};
+    imageAreas[1] = {head.vecLow, head.vecHigh,
+                        (intptr_t) vecDest - (intptr_t) head.vecLow};
+    imageAreas[2] = {head.codeLow, head.codeHigh, codeMove};
+    for (int i = 0; i < 3; ++i)
+        imageAreas[3+i] = {head.roots[i], head.roots[i] + imageRoots[i].bytes,
+                    (intptr_t) imageRoots[i].ptr - (intptr_t) head.roots[i]};
+
+    auto src = (uint8_t const*) (&head + 1);
+    uint32_t rootBytes = 0;
+    for (auto& e : imageRoots)
+        rootBytes += e.bytes;
+    imageBits = (uint8_t*) src + rootBytes + objBytes + vecBytes;
+    imageNext = 0;
+
+    for (auto& e : imageRoots) {
+        memcpy(e.ptr, src, e.bytes);
+        fixWords(e.ptr, e.bytes);
+        src += e.bytes;
+    }
+    memcpy(objDest, src, objBytes);
+    fixWords(objDest, objBytes);
+    memcpy(vecDest, src + objBytes, vecBytes);
+    fixWords(vecDest, vecBytes);
+    imageBits = nullptr;
+
+    objAdopt(objDest);
+    vecAdopt(vecDest + vecBytes);
+    return true;
 }
 
 #if 0
@@ -92,6 +536,80 @@ static void duff (void* dst, void const* src, size_t len) {
 }
 #endif
 
+// Timeouts are kept in a binary min-heap, shared by all events and ordered by
+// deadline: adding or removing one is O(log n), and the first one to expire is
+// always on top. Deadlines are in ms, modulo 2^32, i.e. at most ≈ 24 days out.
+// Each waiting task knows its position in the heap, so it can be removed again.
+
+static auto before (uint32_t a, uint32_t b) -> bool {
+    return (int32_t) (a - b) < 0; // must be modulo 32-bit!
+}
+
+static void timerPlace (uint32_t i) {
+    Event::timers[2*i].asType<Context>()._timer = i + 1;
+}
+
+static void timerSwap (uint32_t i, uint32_t j) {
+    auto& t = Event::timers;
+    auto& d = Event::dues;
+    Value task = t[2*i], evt = t[2*i+1];
+    t[2*i] = t[2*j];
+    t[2*i+1] = t[2*j+1];
+    t[2*j] = task;
+    t[2*j+1] = evt;
+    auto due = d[i];
+    d[i] = d[j];
+    d[j] = due;
+    timerPlace(i);
+    timerPlace(j);
+}
+
+static void timerUp (uint32_t i) {
+    auto& d = Event::dues;
+    while (i > 0 && before(d[i], d[(i-1)/2])) {
+        timerSwap(i, (i-1)/2);
+        i = (i-1)/2;
+    }
+}
+
+static void timerDown (uint32_t i) {
+    auto& d = Event::dues;
+    while (true) {
+        auto c = 2*i + 1;
+        if (c >= d.size())
+            break;
+        if (c + 1 < d.size() && before(d[c+1], d[c]))
+            ++c;
+        if (!before(d[c], d[i]))
+            break;
+        timerSwap(i, c);
+        i = c;
+    }
+}
+
+static void timerAdd (Context& task, Event& evt, uint32_t due) {
+    auto n = Event::dues.size();
+    Event::dues.append(due);
+    Event::timers.append(&task);
+    Event::timers.append(&evt);
+    timerPlace(n);
+    timerUp(n);
+}
+
+static void timerRemove (Context& task) {
+    auto i = task._timer - 1;
+    auto last = Event::dues.size() - 1;
+    if (i < last)
+        timerSwap(i, last);
+    Event::dues.remove(last);
+    Event::timers.remove(2*last, 2);
+    task._timer = 0;
+    if (i < last) {
+        timerDown(i);
+        timerUp(i);
+    }
+}
+
 auto Event::regHandler () -> uint32_t {
     _id = triggers.find({});
     if (_id >= (int) triggers.size())
@@ -114,8 +632,13 @@ auto Event::set () -> Value {
     auto n = _queue.size();
     if (n > 0) {
         // insert all entries at head of ready and remove them from this event
-        Context::ready.insert(0, n);
-        memcpy(Context::ready.begin(), _queue.begin(), n * sizeof (Value));
+        for (auto i = n; i > 0; --i) {
+            auto& task = _queue[i-1].asType<Context>();
+            if (task._timer > 0)
+                timerRemove(task);
+            task._transfer = True; // this will be the result of its wait() call
+            Context::ready.push(task);
+        }
         if (_id >= 0)
             queued -= n;
         assert(queued >= 0);
@@ -126,60 +649,44 @@ auto Event::set () -> Value {
 
 auto Event::wait (int ms) -> Value {
     if (_value)
-        return {};
+        return True; // as when resumed by set()
     if (_id >= 0)
         ++queued;
 
-    //FIXME!
-    //uint16_t remain = _deadline - nowAsTicks(); // must be modulo 16-bit!
-    uint16_t remain = _deadline;
-    if (remain <= 60000 && ms < remain)
-        _deadline -= remain - ms; // deadline must happen sooner
-
     assert(Context::current != nullptr);
     //FIXME? return Context::current->suspend(_queue, ms);
+    remember(*this);
     _queue.append(Context::current);
+    if (ms >= 0 && clock != nullptr)
+        timerAdd(*Context::current, *this, clock() + ms);
     Context::current = nullptr;
     Context::setPending(0);
     return {};
 }
 
-// Timeouts use deadlines instead of down counters, as this avoids having to
-// constantly adjust N counters on each tick. The logic is done modulo 65536,
-// because 16-bit arithmetic is so easy to do: just use a uint16_t.
-//
-// With deadlines, the remaining time is always: (deadline - now) % 65536
-// As the maximum valid timeout is 60s, this leads to the following ranges:
-//
-//      0 .. 60000 = ms ticks remaining before this timeout expires
-//  60001 .. 65535 = the deadline has passed, but not yet dealt with
-//
-//  Each events will keep track of a "combined deadline", i.e. a deadline which
-//  is guaranteed to be no later than the earliest one currently queued up. As
-//  there's always a deadline, there may be "unused" triggers once every 60s.
-
-auto Event::triggerExpired (uint32_t now) -> uint32_t {
-    auto n = _queue.size();
-    if (n == 0) // nothing queued
-        return 0;
-    uint16_t next = _deadline - now; // must be modulo 16-bit!
-    if (next == 0 || next > 60000) {
-        next = 60000;
-        while (n-- > 0) { // loop from the end because queue items may get deleted
-            auto& task = _queue[n].asType<Context>();
-            uint16_t remain = task._transfer - now; // must be modulo 16-bit!
-            if (remain == 0 || remain > 60000) { // can exceed deadline by max ≈ 5s
-                --queued;
-                _queue.remove(n);
-                Context::ready.append(task);
-                //task.timedOut(*this);
-            } else if (next > remain)
-                next = remain;
-        }
-        _deadline = now + next;
+// A timed out task is taken off its event's queue and resumed, with False as
+// the result of its wait() call. Tasks which get resumed by Event::set() first
+// have their timer removed instead, and get True. Timeouts are checked in O(1).
+
+void Event::expire (uint32_t now) {
+    while (dues.size() > 0 && !before(now, dues[0])) {
+        auto& task = timers[0].asType<Context>();
+        auto& evt = timers[1].asType<Event>();
+        timerRemove(task);
+
+        auto& q = evt._queue;
+        for (uint32_t i = 0; i < q.size(); ++i)
+            if (&q[i].obj() == &task) {
+                q.remove(i);
+                break;
+            }
+        if (evt._id >= 0)
+            --queued;
+        assert(queued >= 0);
+
+        task._transfer = False;
+        Context::ready.append(task);
     }
-    assert(next > 0);
-    return next;
 }
 
 auto Event::unop ([[maybe_unused]] UnOp op) const -> Value {
@@ -196,9 +703,299 @@ void Event::repr (Buffer& buf) const {
     Object::repr(buf);
 }
 
+// A channel ring is a bounded MPSC queue, shared by all isolates. Senders
+// claim a slot by bumping the head with a compare-and-swap, then publish it by
+// bumping the sequence number of that slot. The one receiver takes the slots
+// in order, at the tail. Small payloads are copied into the slot itself,
+// larger ones into an off-heap buffer, which the receiver then adopts as is.
+// The only lock is for looking up rings by name. Senders then flag a wakeup
+// word in the ring, which the receiver's isolate polls: no other isolate ever
+// touches its state, since that isolate could go away at any time.
+
+constexpr uint32_t INLINE_MAX = 48;     // larger payloads need a buffer
+constexpr uint32_t STR_FLAG = 1U << 31; // set in ChanSlot::len for str's
+
+struct ChanSlot {
+    uint32_t seq;   // == pos: free for sending, == pos+1: ready to receive
+    uint32_t len;   // payload size, plus STR_FLAG
+    uint8_t* buf;   // off-heap buffer, or null if the payload is inline
+    uint8_t data [INLINE_MAX];
+};
+
+struct monty::ChanRing {
+    ChanRing* next;             // list of all rings, see Channel::Channel
+    uint32_t refs;              // channels using this ring, in any isolate
+    uint32_t mask;              // number of slots - 1, a power of 2
+    uint32_t head;              // next slot to send, shared by all senders
+    uint32_t tail;              // next slot to receive, only used by receiver
+    uint32_t wakeup;            // set by senders, cleared by the receiver
+    bool taken;                 // set once a channel is the receiver
+    ChanRing* polled;           // next ring polled by the receiver's isolate
+    uint32_t bit;               // ... and its pending bit to set on wakeup
+    char name [16];             // only the first 15 chars are significant
+
+    auto slots () -> ChanSlot* { return (ChanSlot*) (this + 1); }
+
+    auto push (void const* ptr, uint32_t len, bool str) -> bool;
+    auto peek () -> ChanSlot*; // the next slot to receive, or null
+    void pop (); // done with the peeked slot, which can now be re-used
+};
+
+static ChanRing* rings; // all the rings in this process, across isolates
+static bool ringsLock;
+static ISOLATE ChanRing* polled; // the rings which this isolate receives on
+
+static void spinLock (bool& lock) {
+    while (__atomic_test_and_set(&lock, __ATOMIC_ACQUIRE)) {}
+}
+
+static void spinUnlock (bool& lock) {
+    __atomic_clear(&lock, __ATOMIC_RELEASE);
+}
+
+auto ChanRing::push (void const* ptr, uint32_t len, bool str) -> bool {
+    auto pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    ChanSlot* slot;
+    while (true) {
+        slot = slots() + (pos & mask);
+        int32_t dif = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos;
+        if (dif < 0)
+            return false; // full
+        if (dif > 0) // another sender got here first
+            pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        else if (__atomic_compare_exchange_n(&head, &pos, pos + 1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+
+    // the slot is now owned by this sender, until it is published
+    slot->buf = nullptr;
+    auto dest = slot->data;
+    if (len > INLINE_MAX) {
+        dest = slot->buf = (uint8_t*) malloc(len + 1);
+        assert(dest != nullptr);
+        dest[len] = 0; // so that str's can use the buffer as is
+    }
+    memcpy(dest, ptr, len);
+    slot->len = len | (str ? STR_FLAG : 0);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+auto ChanRing::peek () -> ChanSlot* {
+    auto slot = slots() + (tail & mask);
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + 1)
+        return nullptr;
+    return slot;
+}
+
+void ChanRing::pop () {
+    auto slot = slots() + (tail & mask);
+    __atomic_store_n(&slot->seq, tail + mask + 1, __ATOMIC_RELEASE);
+    ++tail;
+}
+
+// a payload in an off-heap buffer, which was handed over by a channel: the
+// buffer is used as is and freed when this object is deleted
+template< typename T >
+struct Handoff : T {
+    Handoff (uint8_t* buf, uint32_t len)
+        : T (T::SHARED, (char const*) buf, len) {}
+    ~Handoff () override { free(T::begin()); }
+};
+
+Channel::Channel (char const* name, uint32_t size) {
+    spinLock(ringsLock);
+    auto r = rings;
+    while (r != nullptr && strncmp(r->name, name, sizeof r->name - 1) != 0)
+        r = r->next;
+    if (r == nullptr) {
+        uint32_t n = 2;
+        while (n < size)
+            n *= 2;
+        r = (ChanRing*) calloc(1, sizeof (ChanRing) + n * sizeof (ChanSlot));
+        assert(r != nullptr);
+        r->mask = n - 1;
+        strncpy(r->name, name, sizeof r->name - 1);
+        for (uint32_t i = 0; i < n; ++i)
+            r->slots()[i].seq = i;
+        r->next = rings;
+        rings = r;
+    }
+    ++r->refs;
+    spinUnlock(ringsLock);
+    _ring = r;
+}
+
+Channel::~Channel () {
+    auto& r = *_ring;
+    if (_id >= 0) { // this was the receiver
+        for (auto p = &polled; *p != nullptr; p = &(*p)->polled)
+            if (*p == &r) {
+                *p = r.polled;
+                break;
+            }
+        __atomic_clear(&r.taken, __ATOMIC_RELEASE);
+    }
+
+    spinLock(ringsLock);
+    auto last = --r.refs == 0;
+    if (last)
+        for (auto p = &rings; *p != nullptr; p = &(*p)->next)
+            if (*p == &r) {
+                *p = r.next;
+                break;
+            }
+    spinUnlock(ringsLock);
+
+    if (last) { // no one else can use it now, drop all undelivered messages
+        for (ChanSlot* slot; (slot = r.peek()) != nullptr; r.pop())
+            free(slot->buf);
+        free(&r);
+    }
+}
+
+auto Channel::next () -> Value {
+    while (_queue.size() > 0) {
+        auto msg = take();
+        if (msg.isNil())
+            break;
+        auto& task = _queue[0].asType<Context>();
+        _queue.remove(0);
+        --queued;
+        assert(queued >= 0);
+        task._transfer = msg; // this will be the result of its recv() call
+        remember(task);
+        Context::ready.append(task);
+    }
+    return {};
+}
+
+auto Channel::send (Value msg) -> Value {
+    char const* ptr;
+    uint32_t len;
+    auto str = true;
+    if (msg.isStr()) {
+        ptr = msg;
+        len = strlen(ptr);
+    } else if (auto s = msg.ifType<Str>(); s != nullptr) {
+        ptr = *s;
+        len = s->size();
+    } else if (auto b = msg.ifType<Bytes>(); b != nullptr) {
+        ptr = (char const*) b->begin();
+        len = b->size();
+        str = false;
+    } else
+        return {E::TypeError, "bytes or str expected", msg};
+
+    if (!_ring->push(ptr, len, str))
+        return False;
+    __atomic_store_n(&_ring->wakeup, 1, __ATOMIC_RELEASE);
+    return True;
+}
+
+auto Channel::recv () -> Value {
+    if (_id < 0) {
+        if (__atomic_test_and_set(&_ring->taken, __ATOMIC_ACQUIRE))
+            return {E::RuntimeError, "channel has another receiver"};
+        _ring->bit = regHandler();
+        _ring->polled = polled;
+        polled = _ring;
+    }
+
+    auto msg = take();
+    if (msg.isNil())
+        return wait(); // suspends, until next() passes in a message
+    return msg;
+}
+
+auto Channel::take () -> Value {
+    auto slot = _ring->peek();
+    if (slot == nullptr)
+        return {};
+    auto len = slot->len & ~STR_FLAG;
+    auto str = (slot->len & STR_FLAG) != 0;
+    Value msg;
+    if (slot->buf == nullptr)
+        msg = str ? (Object*) new Str ((char const*) slot->data, len)
+                  : (Object*) new Bytes (slot->data, len);
+    else
+        msg = str ? (Object*) new Handoff<Str> (slot->buf, len)
+                  : (Object*) new Handoff<Bytes> (slot->buf, len);
+    _ring->pop();
+    return msg;
+}
+
+// turn the wakeups from senders into triggers for this isolate's channels
+static void pollRings () {
+    for (auto r = polled; r != nullptr; r = r->polled)
+        if (__atomic_exchange_n(&r->wakeup, 0, __ATOMIC_ACQUIRE) != 0)
+            Stacklet::setPending(r->bit);
+}
+
+auto Channel::create (ArgVec const& args, Type const*) -> Value {
+    //CG: args name:s ? size:i
+    return new Channel (name, size > 0 ? size : 16);
+}
+
+void Channel::repr (Buffer& buf) const {
+    buf.print("<channel '%s'>", _ring->name);
+}
+
+// the ring is always full when it grows, so the part from the head up to the
+// end of the old capacity moves to the end of the new one, keeping the order
+void RunQueue::grow () {
+    auto n = cap();
+    adj(n < 4 ? 4 : 2 * n);
+    auto m = cap();
+    move(_head, n - _head, m - n);
+    wipe(_head, m - n);
+    if (_count > 0)
+        _head += m - n;
+    _fill = m; // this marks all slots, unused ones are nil
+}
+
+auto RunQueue::append (Value v) -> Value {
+    if (_count >= cap())
+        grow();
+    (*this)[wrap(_head + _count++)] = v;
+    return {};
+}
+
+void RunQueue::push (Value v) {
+    if (_count >= cap())
+        grow();
+    _head = wrap(_head + cap() - 1);
+    (*this)[_head] = v;
+    ++_count;
+}
+
+auto RunQueue::pull () -> Value {
+    if (_count == 0)
+        return {};
+    Value v = (*this)[_head];
+    (*this)[_head] = {};
+    _head = wrap(_head + 1);
+    --_count;
+    return v;
+}
+
+auto RunQueue::contains (Value v) const -> bool {
+    for (uint32_t i = 0; i < _count; ++i)
+        if (at(i).id() == v.id())
+            return true;
+    return false;
+}
+
+//CG: wrappers RunQueue
+
+Type RunQueue::info (Q(0,"<runqueue>"), &RunQueue::attrs);
+
 void Context::resumeCaller (Value v) {
-    if (_caller != nullptr)
+    if (_caller != nullptr) {
+        remember(*_caller);
         _caller->_transfer = v;
+    }
     else if (v.isOk())
         v.dump("result lost"); // TODO just for debugging
     current = _caller;
@@ -222,12 +1019,25 @@ void Context::exception (Value e) {
     current->raise(e);
 }
 
+// without a VM, only built-ins can be called, and exceptions can't be caught
+auto Context::nested (Value f, ArgVec const& args, Value& res) -> bool {
+    res = f->call(args);
+    return true;
+}
+
+auto Context::callNow (Value f, ArgVec const& args, Value& res) -> bool {
+    if (current != nullptr)
+        return current->nested(f, args, res);
+    res = f->call(args);
+    return true;
+}
+
 #if 0
 void Stacklet::yield (bool fast) {
     if (fast) {
         if (pending == 0)
             return; // don't yield if there are no pending triggers
-        assert(Context::ready.find(this) >= Context::ready.size());
+        assert(!Context::ready.contains(this));
         Context::ready.push(this);
         suspend();
     } else
@@ -278,6 +1088,8 @@ auto Context::runLoop () -> bool {
     while (true) {
         INNER_HOOK
 
+        Obj::arenaHold(true); // no task is running
+        pollRings();
         auto flags = clearAllPending();
         for (auto e : Event::triggers)
             if (flags != 0) {
@@ -286,21 +1098,37 @@ auto Context::runLoop () -> bool {
                 flags >>= 1;
             }
 
+        if (arenaTask != nullptr && arenaTask->size() == 0)
+            releaseArena(); // the task is done, its stack is gone
+
+        if (Event::clock != nullptr)
+            Event::expire(Event::clock());
+
+        if (gcPhase != 0 || gcCheck())
+            gcMinor();
+
         current = (Context*) &ready.pull().obj();
         if (current == nullptr)
             break;
+        remember(*current); // its stack will change, without write barrier
+
+        if (current->_arena && arenaTask == nullptr) {
+            arenaTask = current;
+            Obj::arenaOpen();
+        }
+        Obj::arenaHold(current != arenaTask);
 
         if (current->cap() > current->_fill + sizeof (jmp_buf) / sizeof (Value))
             longjmp(*(jmp_buf*) current->end(), 1);
 
         while (current->run() && pending == 0) {}
 
-        assert(ready.find(current) >= ready.size());
+        assert(!ready.contains(current));
         if (current != nullptr)
             ready.push(current);
     }
 
-    return Event::queued > 0 || ready.size() > 0;
+    return Event::queued > 0 || ready.len() > 0 || Event::dues.size() > 0;
 }
 
 void Module::repr (Buffer& buf) const {
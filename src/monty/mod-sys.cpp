@@ -13,6 +13,57 @@ static auto f_gc () -> Value {
     return {};
 }
 
+// sets the gc policy tunables, in order, and returns them all as a list
+//CG1 bind gcpolicy *
+static auto f_gcpolicy (ArgVec const& args) -> Value {
+    if (args.size() > 0)
+        gcPolicy.minFree = args[0];
+    if (args.size() > 1)
+        gcPolicy.growth = args[1];
+    if (args.size() > 2)
+        gcPolicy.maxCost = args[2];
+    auto r = new List;
+    r->append(gcPolicy.minFree);
+    r->append(gcPolicy.growth);
+    r->append(gcPolicy.maxCost);
+    return r;
+}
+
+// the objects which this task allocates are released in one go when it ends,
+// except those which escape, so it must be called before the task starts
+//CG1 bind arena arg
+static auto f_arena (Value arg) -> Value {
+    auto task = arg.isObj() ? arg.obj().asTask() : nullptr;
+    if (task == nullptr)
+        return {E::TypeError, "not a task", arg};
+    task->_arena = true; // as in sys.ready.append(task)
+    return {};
+}
+
+//CG1 bind heaptrack arg
+static auto f_heaptrack (Value arg) -> Value {
+    HeapProf::track(arg.truthy());
+    return {};
+}
+
+//CG1 bind heaptypes
+static auto f_heaptypes () -> Value {
+    return HeapProf::types();
+}
+
+//CG1 bind heapsites
+static auto f_heapsites () -> Value {
+    return HeapProf::sites();
+}
+
+// prints a snapshot, to be captured from the console for offline analysis
+//CG1 bind heapdump
+static auto f_heapdump () -> Value {
+    Buffer buf;
+    HeapProf::dump(buf);
+    return {};
+}
+
 #if 0
 // CG1 bind gcmax
 static auto f_gcmax () -> Value {
@@ -28,13 +79,24 @@ static auto f_gcstats () -> Value {
 }
 #endif
 
+// these attributes are per-isolate state, so they're not in the static map
+struct SysAttrs : Lookup {
+    using Lookup::Lookup;
+
+    auto getAt (Value k) const -> Value override {
+        switch (k.asQid()) {
+            case Q(0,"ready"):    return Context::ready;
+            case Q(0,"modules"):  return Module::loaded;
+            case Q(0,"builtins"): return Module::builtins;
+        }
+        return Lookup::getAt(k);
+    }
+};
+
 //CG1 wrappers
 static Lookup::Item const sys_map [] = {
-    { Q(0,"ready"), Context::ready },
-    { Q(0,"modules"), Module::loaded },
-    { Q(0,"builtins"), Module::builtins },
     { Q(0,"implementation"), Q(0,"monty") },
     { Q(0,"version"), VERSION },
 };
 
-//CG: module-end
+//CG: module-end SysAttrs
@@ -163,6 +163,30 @@ TEST_CASE("mem") {
         (void) p5; // TODO changed: CHECK(p3 == p5);
     }
 
+    SUBCASE("freeLists") {
+        MarkObj* p [6];
+        for (auto& e : p)
+            e = new (16) MarkObj;
+        mark(p[0]); mark(p[2]); mark(p[4]);
+        Obj::sweep();                   // [ p4 gap p2 gap p0 gap ]
+        auto avail = gcMax();
+
+        auto p6 = new (16) MarkObj;     // exact fit, from the free lists
+        CHECK((p6 == p[1] || p6 == p[3] || p6 == p[5]));
+        CHECK(avail == gcMax());
+        auto p7 = new MarkObj;          // smaller, splits a free object
+        CHECK(avail == gcMax());
+        CHECK(Obj::inPool(p7));
+
+        delete p[2];                    // [ p4 gap gap gap p0 gap ]
+        auto p8 = new (16) MarkObj;     // re-used, no merging in between
+        CHECK(p8 == p[2]);
+        CHECK(avail == gcMax());
+
+        delete p[4];                    // lowest object, so objLow goes up
+        CHECK(avail < gcMax());
+    }
+
     SUBCASE("outOfObjs") {
 #if 0 // can't test this anymore, since panic can't return
         constexpr auto N = 400;
@@ -230,3 +254,361 @@ TEST_CASE("mem") {
     Obj::sweep();
     CHECK(memAvail == gcMax());
 }
+
+// allocation cost in a fragmented pool, measured as slots visited per request
+// (a deterministic stand-in for latency), with and without the free lists
+TEST_CASE("alloc latency") {
+    static uint8_t memory [64*1024];
+    objInit(memory, sizeof memory);
+    uint32_t memAvail = gcMax();
+    created = destroyed = 0;
+
+    constexpr int N = 500;
+    static uint16_t cost [N/2];
+
+    auto run = [&](bool useLists) -> int {
+        static MarkObj* objs [N];
+        for (int i = 0; i < N; ++i)
+            objs[i] = new ((i % 5) * 16) MarkObj;
+        for (int i = 0; i < N; i += 2)
+            mark(objs[i]);
+        Obj::sweep(); // every other object is now a gap
+        if (!useLists)
+            dropFreeLists();
+
+        for (int i = 0; i < N/2; ++i) {
+            auto before = objStats.walks;
+            new ((i % 5) * 16) MarkObj;
+            cost[i] = objStats.walks - before;
+        }
+
+        for (int i = 1; i < N/2; ++i) // insertion sort, to get percentiles
+            for (int j = i; j > 0 && cost[j-1] > cost[j]; --j) {
+                auto t = cost[j]; cost[j] = cost[j-1]; cost[j-1] = t;
+            }
+        MESSAGE((useLists ? "free lists" : "pool scan "),
+                    ": p50 ", cost[N/4], " p90 ", cost[N/2*9/10],
+                    " p99 ", cost[N/2*99/100], " max ", cost[N/2-1], " slots");
+
+        Obj::sweep();
+        Obj::sweep();
+        CHECK(memAvail == gcMax());
+        return cost[N/2-1];
+    };
+
+    CHECK(run(false) > N/4);
+    CHECK(run(true) == 0);
+}
+
+// objects which can be re-linked after construction, to exercise the barrier
+struct LinkObj : Obj {
+    LinkObj (Obj* o =0) : other (o) { ++created; }
+    ~LinkObj () override            { ++destroyed; }
+
+    void marker () const override   { ++marked; mark(other); }
+
+    Obj* other;
+};
+
+TEST_CASE("generations") {
+    uint8_t memory [3*1024];
+    objInit(memory, sizeof memory);
+    gcNursery(sizeof memory / 4);
+    uint32_t memAvail = gcMax();
+    created = destroyed = marked = 0;
+
+    auto p1 = new LinkObj;
+    mark(p1);
+    Obj::sweep();                       // p1 survived, so it's now old
+    CHECK(0 == destroyed);
+    CHECK(!gcCheck());
+
+    SUBCASE("minor") {
+        auto p2 = new LinkObj;          // young, and only reachable via p1
+        /* p3: */ new LinkObj;          // young garbage
+        p1->other = p2;
+        remember(*p1);
+
+        marked = 0;
+        CHECK(Obj::minorStart());       // traces the remembered set
+        CHECK(2 == marked);
+        mark(p1);                       // old objects are not traced
+        CHECK(2 == marked);
+        Obj::minorSweep();
+        CHECK(1 == destroyed);          // only p3 has been reclaimed
+
+        p1->other = nullptr;            // p2 is old now, and stays put
+        CHECK(Obj::minorStart());
+        Obj::minorSweep();
+        CHECK(1 == destroyed);
+    }
+
+    SUBCASE("nursery") {
+        auto n = 0;
+        while (!gcCheck()) {            // fill the nursery with garbage
+            new LinkObj;
+            ++n;
+        }
+        CHECK(n > 10);
+        CHECK(Obj::minorStart());
+        Obj::minorSweep();
+        CHECK(n == destroyed);
+        CHECK(!gcCheck());
+    }
+
+    SUBCASE("overflow") {
+        LinkObj* objs [REM_MAX+1];
+        for (auto& e : objs) {
+            e = new LinkObj;
+            mark(e);
+        }
+        Obj::sweep();
+        for (auto e : objs)
+            remember(*e);               // one too many to keep track of
+        CHECK(!Obj::minorStart());      // this needs a full gc
+    }
+
+    Obj::sweep();
+    CHECK(created == destroyed);
+    CHECK(memAvail == gcMax());
+}
+
+TEST_CASE("incremental") {
+    uint8_t memory [3*1024];
+    objInit(memory, sizeof memory);
+    uint32_t memAvail = gcMax();
+    created = destroyed = marked = 0;
+
+    auto a = new LinkObj;
+    auto b = new LinkObj;
+    auto c = new LinkObj;
+    a->other = b;
+
+    Obj::markStart();
+    mark(a);
+    CHECK(0 == marked);                 // not traced yet, only stacked
+    auto steps = 0;
+    while (!Obj::markStep(OS_SZ))
+        ++steps;
+    CHECK(steps > 0);
+    CHECK(2 == marked);
+
+    a->other = c;                       // a is black, c is still white ...
+    remember(*a);                       // ... so a must be traced again
+    auto d = new LinkObj;               // allocated during marking
+    Obj::markFinish();
+    CHECK(5 == marked);                 // a, c, and d have been traced
+
+    Obj::sweepStart();
+    auto e = new LinkObj;               // allocated below the sweep cursor
+    steps = 0;
+    while (!Obj::sweepStep(2 * OS_SZ))
+        ++steps;
+    CHECK(steps > 1);
+    CHECK(0 == destroyed);              // b is floating garbage, until next gc
+
+    mark(a);
+    Obj::sweep();
+    CHECK(3 == destroyed);              // b, d, and e are gone now
+    (void) d; (void) e;
+
+    Obj::sweep();
+    CHECK(created == destroyed);
+    CHECK(memAvail == gcMax());
+}
+
+TEST_CASE("mark stack") {
+    uint8_t memory [20*1024];
+    objInit(memory, sizeof memory);
+    uint32_t memAvail = gcMax();
+    created = destroyed = marked = 0;
+
+    constexpr auto N = 200;             // much longer than the mark stack
+    LinkObj* head = nullptr;
+    for (int i = 0; i < N; ++i)
+        head = new LinkObj (head);
+
+    SUBCASE("chain") {
+        mark(head);                     // each object stacks the next one
+        CHECK(N == marked);
+        Obj::sweep();
+        CHECK(0 == destroyed);
+    }
+
+    SUBCASE("fan-out") {
+        LinkObj* objs [N];              // too many at once, some turn gray
+        for (auto& e : objs)
+            e = new LinkObj (head);
+        Obj::markStart();
+        for (auto e : objs)
+            mark(e);
+        CHECK(0 == marked);
+        Obj::markFinish();
+        CHECK(2*N == marked);
+        Obj::sweepStart();
+        while (!Obj::sweepStep(~0U)) {}
+        CHECK(0 == destroyed);
+    }
+
+    Obj::sweep();
+    CHECK(created == destroyed);
+    CHECK(memAvail == gcMax());
+}
+
+TEST_CASE("walk") {
+    uint8_t memory [3*1024];
+    objInit(memory, sizeof memory);
+    created = destroyed = marked = 0;
+
+    auto a = new LinkObj;
+    auto b = new LinkObj (a);
+    delete new LinkObj;                 // leaves a free slot behind
+    auto c = new LinkObj (b);
+
+    static int count;
+    static uint32_t total;
+    count = total = 0;
+    Obj::walk([](Obj const&, uint32_t bytes) {
+        ++count;
+        total += bytes;
+    });
+    CHECK(3 == count);
+    CHECK(total >= 3 * sizeof (LinkObj));
+
+    CHECK(Obj::findOwner(&b->other) == b);
+    CHECK(Obj::findOwner(&c->other) == c);
+    CHECK(Obj::findOwner(&count) == nullptr);
+
+    mark(c);
+    Obj::sweep();
+    Obj::sweep();
+    CHECK(created == destroyed);
+}
+
+TEST_CASE("adaptive trigger") {
+    uint8_t memory [4*1024];
+    objInit(memory, sizeof memory);
+    created = destroyed = marked = 0;
+
+    auto n = 0;
+    while (!gcCheck()) {                // only garbage, triggers at minFree
+        new LinkObj;
+        ++n;
+    }
+    CHECK(n > 10);
+    Obj::sweep();
+    CHECK(!gcCheck());
+
+    LinkObj* head = nullptr;
+    for (int i = 0; i < 20; ++i)
+        head = new LinkObj (head);
+    mark(head);
+    Obj::sweep();                       // all survived, next = 150% of live
+
+    n = 0;
+    while (!gcCheck()) {
+        new LinkObj;
+        ++n;
+    }
+    CHECK(n > 20);
+    auto n1 = n;
+
+    gcPolicy.growth = 50;
+    mark(head);
+    Obj::sweep();                       // 40% survived, next = 50% of live
+
+    n = 0;
+    while (!gcCheck()) {
+        new LinkObj;
+        ++n;
+    }
+    CHECK(n < n1);
+
+    gcPolicy.minFree = 95;              // less than that is always free
+    CHECK(gcCheck());
+
+    gcPolicy = {};
+    Obj::sweep();
+    Obj::sweep();
+    CHECK(created == destroyed);
+}
+
+static uint8_t *growLimit, *growFloor; // the test pool can grow down to limit
+
+TEST_CASE("growable pool") {
+    uint8_t memory [16*1024];
+    growLimit = memory;
+    growFloor = memory + sizeof memory - 1024;
+    objInit(growFloor, 1024);
+    created = destroyed = marked = 0;
+
+    objGrow = [](uint32_t bytes) -> void* {
+        if (bytes < 512)
+            bytes = 512;
+        if (growFloor - bytes < growLimit)
+            return nullptr;
+        growFloor -= bytes;
+        return growFloor;
+    };
+
+    LinkObj* head = nullptr;
+    for (int i = 0; i < 100; ++i)       // more than fits in the initial pool
+        head = new LinkObj (head);
+    CHECK(growFloor < memory + sizeof memory - 1024);
+    CHECK(gcMax() < 512);
+
+    auto floor = growFloor;
+    mark(head);
+    Obj::sweep();                       // all survived, so grow for a cycle
+    CHECK(growFloor < floor);
+    CHECK(!gcCheck());
+
+    objGrow = nullptr;
+    Obj::sweep();
+    Obj::sweep();
+    CHECK(created == destroyed);
+}
+
+TEST_CASE("arena") {
+    uint8_t memory [3*1024];
+    objInit(memory, sizeof memory);
+    uint32_t memAvail = gcMax();
+    created = destroyed = marked = 0;
+
+    auto root = new LinkObj;            // in the shared heap
+    mark(root);
+    Obj::sweep();
+    CHECK(!Obj::arenaStart());          // no arena open
+
+    SUBCASE("release") {
+        Obj::arenaOpen();
+        auto keep = new LinkObj;
+        for (int i = 0; i < 10; ++i)
+            new LinkObj (keep);         // temporaries
+        root->other = keep;             // this one escapes
+        remember(*root);
+
+        CHECK(Obj::arenaStart());
+        Obj::arenaSweep();
+        CHECK(10 == destroyed);
+        CHECK(!Obj::arenaStart());      // it has been closed
+    }
+
+    SUBCASE("promote") {
+        Obj::arenaOpen();
+        auto keep = new LinkObj;
+        /* temp: */ new LinkObj;
+        mark(root);
+        mark(keep);
+        Obj::sweep();                   // keep is now in the shared heap
+        CHECK(1 == destroyed);
+
+        CHECK(Obj::arenaStart());
+        Obj::arenaSweep();
+        CHECK(1 == destroyed);          // it's not reachable, but not released
+    }
+
+    Obj::sweep();
+    CHECK(created == destroyed);
+    CHECK(memAvail == gcMax());
+}
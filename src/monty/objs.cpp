@@ -20,17 +20,25 @@ static void V (Obj const& o, char const* s) {
 #endif
 
 struct ObjSlot {
-    auto next () const -> ObjSlot* { return (ObjSlot*) (flag & ~1); }
+    auto next () const -> ObjSlot* { return (ObjSlot*) (flag & ~7); }
     auto isFree () const -> bool   { return vt == nullptr; }
     auto isLast () const -> bool   { return chain == nullptr; }
     auto isMarked () const -> bool { return (flag & 1) != 0; }
     void setMark ()                { flag |= 1; }
     void clearMark ()              { flag &= ~1; }
+    auto isRemembered () const -> bool { return (flag & 2) != 0; }
+    void setRemembered ()          { flag |= 2; }
+    void clearRemembered ()        { flag &= ~2; }
+    auto isGray () const -> bool   { return (flag & 4) != 0; }
+    void setGray ()                { flag |= 4; }
+    void clearGray ()              { flag &= ~4; }
+    auto slots () const -> uint32_t { return chain - this; }
+    auto link () -> ObjSlot*&      { return this[1].chain; } // free, 2+ slots
 
     // field order is essential, vt must be last
     union {
         ObjSlot* chain;
-        uintptr_t flag; // bit 0 set for marked objects
+        uintptr_t flag; // bits 0..2: marked, remembered, and gray objects
     };
     void* vt; // null for deleted objects
 };
@@ -39,24 +47,165 @@ constexpr auto PTR_SZ = sizeof (void*);
 constexpr auto OS_SZ  = sizeof (ObjSlot);
 
 static_assert (OS_SZ == 2 * PTR_SZ, "wrong ObjSlot size");
+static_assert (OS_SZ >= 8, "need 3 flag bits in ObjSlot::chain");
 
-static uintptr_t* start;    // start of memory pool, aligned to VS_SZ-PTR_SZ
-static uintptr_t* limit;    // limit of memory pool, aligned to OS_SZ-PTR_SZ
+static ISOLATE uintptr_t* start;   // start of memory pool, VS_SZ-PTR_SZ align
+static ISOLATE uintptr_t* limit;   // limit of memory pool, OS_SZ-PTR_SZ align
 
-static ObjSlot* objLow;     // low water mark of object memory pool
-static ObjSlot* objBottom;  // high water mark of vector memory pool
+static ISOLATE ObjSlot* objLow;    // low water mark of object memory pool
+static ISOLATE ObjSlot* objBottom; // high water mark of vector memory pool
+static ISOLATE uint32_t epoch;     // bumped by objInit, to detect stale ptrs
 
 union ObjStats {
     struct {
         int
-            checks, sweeps, compacts,
+            checks, sweeps, minors, compacts,
             toa, tob, tva, tvb, // total Obj/Vec Allocs/Bytes
             coa, cob, cva, cvb, // curr  Obj/Vec Allocs/Bytes
-            moa, mob, mva, mvb; // max   Obj/Vec Allocs/Bytes
+            moa, mob, mva, mvb, // max   Obj/Vec Allocs/Bytes
+            walks;              // slots visited while scanning for free space
     };
-    int v [15];
+    int v [17];
 };
-ObjStats objStats;
+ISOLATE ObjStats objStats;
+
+// The trigger for full collections adapts to the application: after each one,
+// the amount to allocate before the next is set from the live data (as with
+// Go's GOGC), then adjusted for the fraction which survived: if most objects
+// survive, collecting is not very productive, and vice versa. With a clock,
+// the allocation rate and the time spent in gc are also known, and collection
+// intervals are stretched to keep the cost within gcPolicy.maxCost. Lastly,
+// incremental collections need headroom, since the application continues to
+// allocate during the cycle: the next one is started early enough for that.
+// With a nursery, young objects only count as allocated once they're promoted.
+ISOLATE GcPolicy monty::gcPolicy;
+auto (*monty::gcClock) () -> uint32_t;
+
+static ISOLATE uint32_t allocated;  // bytes allocated since the last full gc
+static ISOLATE uint32_t gcNext;     // bytes to allocate before the next gc
+static ISOLATE uint32_t liveBefore; // bytes in use at the start of the gc
+static ISOLATE uint32_t cycleAlloc; // bytes allocated during the last incr gc
+static ISOLATE uint32_t cycleMark;  // value of allocated when this gc started
+static ISOLATE uint32_t gcTicks;    // time spent in gc since the last adjust
+static ISOLATE uint32_t lastAdapt;  // time of the last adjustment
+
+// accumulates the time spent in a gc phase, if there is a clock
+struct GcTimer {
+    GcTimer () : t (gcClock != nullptr ? gcClock() : 0) {}
+    ~GcTimer () { if (gcClock != nullptr) gcTicks += gcClock() - t; }
+
+    uint32_t t;
+};
+
+// ask for more room below the pool, this only succeeds if objGrow is set
+static auto growPool (uint32_t bytes) -> bool {
+    auto floor = objGrow != nullptr ? (ObjSlot*) objGrow(bytes) : nullptr;
+    if (floor == nullptr || floor >= objBottom)
+        return false;
+    objBottom = floor;
+    return true;
+}
+
+// free space in the object pool, including the gaps between objects
+static auto gcFree () -> uint32_t {
+    auto gaps = (uintptr_t) limit - (uintptr_t) objLow - objStats.cob;
+    return gcMax() + gaps;
+}
+
+// set the next trigger point, this is called at the end of each full gc
+static void gcAdapt () {
+    uint32_t live = objStats.cob;
+    uint64_t next = (uint64_t) live * gcPolicy.growth / 100;
+    if (liveBefore > 0) {
+        auto survival = (uint64_t) live * 100 / liveBefore;
+        if (survival > 75)
+            next += next / 2;   // not much garbage, collect less often
+        else if (survival < 25)
+            next -= next / 2;   // lots of garbage, collect more often
+    }
+    if (gcClock != nullptr && gcPolicy.maxCost > 0) {
+        auto now = gcClock();
+        auto elapsed = now - lastAdapt;
+        if (elapsed > 0) {      // min bytes to spread the gc time over
+            auto spread = (uint64_t) allocated * gcTicks * 100 /
+                            ((uint64_t) elapsed * gcPolicy.maxCost);
+            if (next < spread)
+                next = spread;
+        }
+        lastAdapt = now;
+    }
+    auto total = (uintptr_t) limit - (uintptr_t) objBottom;
+    auto low = total * gcPolicy.minFree / 100;
+    if (gcFree() < next + low && growPool(next + low - gcFree())) {
+        total = (uintptr_t) limit - (uintptr_t) objBottom; // room for a cycle
+        low = total * gcPolicy.minFree / 100;
+    }
+    gcNext = next < low ? low : next > total ? total : next;
+    allocated = gcTicks = 0;
+}
+
+// true when the next full collection should be started
+static auto majorDue () -> bool {
+    auto total = (uintptr_t) limit - (uintptr_t) objBottom;
+    auto floor = total * gcPolicy.minFree / 100;
+    if (gcFree() < floor + cycleAlloc)
+        return true; // running low, or the next cycle would run out
+    return allocated >= gcNext;
+}
+
+// Free objects are kept in per-size lists, which are rebuilt after each sweep,
+// so that most allocations can be satisfied without scanning the pool. List 0
+// has all free objects of NUM_CLASSES slots or more. Single-slot objects have
+// no room for a link, these get merged with their neighbours in the next sweep.
+// Scanning the pool merges free slots, which breaks the lists: in that case
+// they are dropped, and allocation falls back to scanning until the next sweep.
+constexpr auto NUM_CLASSES = 16;
+static ISOLATE ObjSlot* freeLists [NUM_CLASSES];
+static ISOLATE bool freeListsOk;
+
+// Objects allocated since the last collection are young, all others are old.
+// Young objects are bump-allocated below nurseryTop, until the nursery is full
+// (after that, free space is re-used, but such "pretenured" objects count as
+// old). A minor collection only marks and sweeps young objects: old ones are
+// not traced, other than those in the remembered set, i.e. old objects which
+// may have been given references to young ones since the last collection.
+// Since objects never move, survivors are promoted by lowering nurseryTop.
+// When the remembered set overflows, the next collection must be a full one.
+constexpr auto REM_MAX = 32;
+static ISOLATE ObjSlot* nurseryTop; // objLow .. nurseryTop is the young gen
+static ISOLATE uint32_t nurseryMax; // nursery size in bytes, 0 = no minor gc's
+static ISOLATE ObjSlot* markFence;  // marking stops here, i.e. at old objects
+static ISOLATE ObjSlot* remSet [REM_MAX];
+static ISOLATE int remFill;
+static ISOLATE bool remOverflow;
+static ISOLATE uint8_t minorRun;    // minor gc's since the last full one
+static ISOLATE ObjSlot* arenaTop;   // objLow .. arenaTop is the open arena
+static ISOLATE bool arenaHeld;      // set while allocating outside the arena
+constexpr auto MAX_MINORS = 20;
+
+// Marking does not recurse: newly marked objects are pushed onto a small mark
+// stack, and their children get marked when they are popped off again. When
+// this stack is full, objects are flagged as gray instead, i.e. marked, but
+// not yet traced. Once the stack is empty, the pool is scanned for them, and
+// that scan starts over if objects behind the cursor were flagged meanwhile.
+// This way, the marking depth is independent of the depth of the object graph.
+constexpr auto MARK_DEPTH = 32;
+static ISOLATE ObjSlot* markStack [MARK_DEPTH];
+static ISOLATE int markFill;
+static ISOLATE bool draining;       // set while tracing, so mark() only pushes
+static ISOLATE ObjSlot* scanNext;   // next slot to visit, or null in between
+static ISOLATE bool grayBehind;     // an object before scanNext turned gray
+static ISOLATE uint8_t markPasses;  // passes in the current marking phase
+constexpr auto MAX_PASSES = 3;
+
+// An incremental gc traces the mark stack in steps, and leaves the remaining
+// objects for the final (non-incremental) mark step after a few scan passes:
+// new objects keep showing up behind the cursor. The write barrier pushes
+// marked objects once more, and new objects are pushed when allocated. Sweep
+// steps use the same cursor, and objects which are allocated ahead of it are
+// marked, so that they won't be reclaimed.
+enum { STOPPED, MARKING, SWEEPING };
+static ISOLATE uint8_t gcMode;      // STOPPED when no incremental gc runs
 
 template< typename T >
 static auto roundUp (uint32_t n) -> uint32_t {
@@ -74,16 +223,211 @@ static auto obj2slot (Obj const& o) -> ObjSlot* {
     return Obj::inPool(&o) ? (ObjSlot*) ((uintptr_t) &o - PTR_SZ) : 0;
 }
 
+static void rememberSlot (ObjSlot& slot) {
+    if (slot.isRemembered())
+        return;
+    if (remFill < REM_MAX) {
+        slot.setRemembered();
+        remSet[remFill++] = &slot;
+    } else
+        remOverflow = true;
+}
+
+static void forgetSlot (ObjSlot& slot) {
+    for (int i = 0; i < remFill; ++i)
+        if (remSet[i] == &slot) {
+            remSet[i] = remSet[--remFill];
+            break;
+        }
+    slot.clearRemembered();
+}
+
+static void forgetAll () {
+    while (remFill > 0)
+        remSet[--remFill]->clearRemembered();
+    remOverflow = false;
+}
+
+// An arena is like a second nursery, inside the first one: while it's open,
+// all new objects are bump-allocated, and the write barrier also covers the
+// objects allocated before it was opened. Releasing it is like a minor gc, but
+// only for the arena's objects. Any collection in the meantime promotes its
+// survivors (they no longer are in the remembered set), so the arena shrinks.
+// The arena can be held, new objects then take the normal path, i.e. they are
+// only bump-allocated in the nursery (which the arena is part of).
+
+// true if the write barrier needs to track changes to this object
+static auto isTenured (ObjSlot const& slot) -> bool {
+    return (nurseryMax > 0 && &slot >= nurseryTop) ||
+            (arenaTop != nullptr && &slot >= arenaTop);
+}
+
+// after a collection, the survivors are old, and the arena starts over
+static void promoteAll () {
+    nurseryTop = objLow;
+    if (arenaTop != nullptr)
+        arenaTop = objLow;
+}
+
+// sweep the young objects below top, without merging
+static void sweepYoung (ObjSlot* top, bool promote) {
+    markFence = (ObjSlot*) limit;
+    for (auto slot = objLow; slot < top; slot = slot->chain)
+        if (slot->isMarked()) {
+            slot->clearMark();
+            if (promote)
+                allocated += (slot->next() - slot) * OS_SZ;
+        } else if (!slot->isFree()) {
+            auto q = (Obj*) &slot->vt;
+            V(*q, "\t delete");
+            delete q; // the slot stays in use if its class recycles it
+        }
+}
+
+// mark everything reachable from the remembered set, but only below fence
+static void traceRemembered (ObjSlot* fence) {
+    markFence = fence;
+    for (int i = 0; i < remFill; ++i)
+        ((Obj const*) &remSet[i]->vt)->marker();
+}
+
+// raise objLow by one object, the nursery and cursor can't be below it
+static void raiseLow () {
+    objLow = objLow->chain;
+    if (nurseryTop < objLow)
+        nurseryTop = objLow;
+    if (arenaTop != nullptr && arenaTop < objLow)
+        arenaTop = objLow;
+    if (scanNext != nullptr && scanNext < objLow)
+        scanNext = objLow;
+}
+
+// add a marked object to the ones which still need to be traced
+static void pushMark (ObjSlot& slot) {
+    if (markFill < MARK_DEPTH)
+        markStack[markFill++] = &slot;
+    else {
+        slot.setGray();
+        if (scanNext == nullptr || &slot < scanNext)
+            grayBehind = true; // the (next) pass has to cover this one
+    }
+}
+
+static void dropMark (ObjSlot& slot) {
+    for (int i = 0; i < markFill; ++i)
+        if (markStack[i] == &slot) {
+            markStack[i] = markStack[--markFill];
+            break;
+        }
+}
+
+// trace stacked and gray objects until done, or until the budget runs out
+static auto traceMarks (uint32_t budget) -> bool {
+    uint32_t work = 0;
+    while (true) {
+        while (markFill > 0) {
+            if (work >= budget)
+                return false;
+            auto slot = markStack[--markFill];
+            ((Obj const*) &slot->vt)->marker();
+            work += (slot->next() - slot) * OS_SZ;
+        }
+        if (scanNext == nullptr) { // start a new pass, if needed
+            if (!grayBehind || markPasses >= MAX_PASSES)
+                return true; // done, or leave it to the next call
+            ++markPasses;
+            scanNext = objLow;
+            grayBehind = false;
+        }
+        while (markFill == 0 && !scanNext->isLast()) {
+            if (work >= budget)
+                return false;
+            work += OS_SZ;
+            auto slot = scanNext;
+            scanNext = slot->next();
+            if (slot->isGray()) {
+                slot->clearGray();
+                markStack[markFill++] = slot;
+            }
+        }
+        if (scanNext->isLast())
+            scanNext = nullptr;
+    }
+}
+
+// trace all marked objects, there's no budget and no limit on the passes
+static void traceAllMarks () {
+    do
+        markPasses = 0;
+    while (!traceMarks(~0U) || grayBehind);
+}
+
+// objects allocated during an incremental gc must not be reclaimed by it
+static auto fresh (ObjSlot* slot) -> void* {
+    if (nurseryMax == 0 || slot >= nurseryTop) // young objects count when old
+        allocated += (slot->next() - slot) * OS_SZ;
+    if (gcMode == MARKING) {
+        slot->setMark();
+        pushMark(*slot);
+    } else if (gcMode == SWEEPING && slot >= scanNext)
+        slot->setMark();
+    return &slot->vt;
+}
+
 static void mergeFreeObjs (ObjSlot& slot) {
     while (true) {
         auto nextSlot = slot.chain;
         assert(nextSlot != nullptr);
         if (!nextSlot->isFree() || nextSlot->isLast())
             break;
+        if (nextSlot == scanNext)
+            scanNext = &slot; // keep the cursor on a slot boundary
         slot.chain = nextSlot->chain;
     }
 }
 
+static void addFree (ObjSlot& slot) {
+    auto n = slot.slots();
+    if (n > 1) {
+        auto& head = freeLists[n < NUM_CLASSES ? n : 0];
+        slot.link() = head;
+        head = &slot;
+    }
+}
+
+static void dropFreeLists () {
+    freeListsOk = false;
+    for (auto& e : freeLists)
+        e = nullptr;
+}
+
+// exact size first, then larger sizes, then the first fit of the large ones
+static auto takeFree (uint32_t needs) -> ObjSlot* {
+    ObjSlot* slot = nullptr;
+    for (auto n = needs; n < NUM_CLASSES && slot == nullptr; ++n)
+        if (freeLists[n] != nullptr) {
+            slot = freeLists[n];
+            freeLists[n] = slot->link();
+        }
+    if (slot == nullptr)
+        for (auto p = &freeLists[0]; *p != nullptr; p = &(*p)->link())
+            if ((*p)->slots() >= needs) {
+                slot = *p;
+                *p = slot->link();
+                break;
+            }
+    if (slot != nullptr && slot->slots() > needs) {
+        // put object at end of free space, and re-file what's left over
+        auto end = slot->chain;
+        slot->chain = end - needs;
+        addFree(*slot);
+        slot = end - needs;
+        slot->chain = end;
+        slot->vt = nullptr;
+    }
+    return slot;
+}
+
 // don't use lambda w/ assert, since Espressif's ESP8266 compiler chokes on it
 // (hmmm, perhaps the assert macro is trying to obtain a function name ...)
 //void* (*panicOutOfMemory)() = []() { assert(false); return nullptr; };
@@ -91,6 +435,8 @@ static void* defaultOutOfMemoryHandler () { assert(false); return nullptr; }
 
 namespace monty {
     void* (*panicOutOfMemory)() = defaultOutOfMemoryHandler;
+    ISOLATE void (*allocHook) (uint32_t bytes);
+    ISOLATE auto (*objGrow) (uint32_t bytes) -> void*;
 
     auto Obj::inPool (void const* p) -> bool {
         return objLow < p && p < limit;
@@ -98,6 +444,8 @@ namespace monty {
 
     auto Obj::operator new (size_t sz) -> void* {
         auto needs = multipleOf<ObjSlot>(sz + PTR_SZ);
+        if (allocHook != nullptr)
+            allocHook(needs * OS_SZ);
 
         ++objStats.toa;
         ++objStats.coa;
@@ -108,31 +456,52 @@ namespace monty {
         if (objStats.mob < objStats.cob)
             objStats.mob = objStats.cob;
 
-        // traverse object pool, merge free slots, loop until first fit
-        for (auto slot = objLow; !slot->isLast(); slot = slot->next())
-            if (slot->isFree()) {
-                mergeFreeObjs(*slot);
+        // young objects are bump-allocated, as long as the nursery has room
+        auto room = objLow - needs >= (void*) objBottom;
+        auto young = (arenaTop != nullptr && !arenaHeld) ||
+                        (nurseryTop - objLow + needs) * OS_SZ <= nurseryMax;
+
+        if (!room || !young) {
+            if (freeListsOk) {
+                auto slot = takeFree(needs);
+                if (slot != nullptr) {
+                    if (isTenured(*slot))
+                        rememberSlot(*slot); // pretenured, may ref young objs
+                    return fresh(slot);
+                }
+                if (!room)
+                    dropFreeLists(); // no room left, try merging free slots
+            }
 
-                int slack = slot->chain - slot - needs;
-                if (slack >= 0) {
-                    if (slack > 0) { // put object at end of free space
-                        slot->chain -= needs;
-                        slot += slack;
-                        slot->chain = slot + needs;
+            // traverse object pool, merge free slots, loop until first fit
+            if (!freeListsOk)
+                for (auto slot = objLow; !slot->isLast(); slot = slot->next()) {
+                    ++objStats.walks;
+                    if (slot->isFree()) {
+                        mergeFreeObjs(*slot);
+
+                        int slack = slot->chain - slot - needs;
+                        if (slack >= 0) {
+                            if (slack > 0) { // put object at end of free space
+                                slot->chain -= needs;
+                                slot += slack;
+                                slot->chain = slot + needs;
+                            }
+                            return fresh(slot);
+                        }
                     }
-                    return &slot->vt;
                 }
-            }
 
-        if (objLow - needs < (void*) objBottom)
-            return panicOutOfMemory(); // give up
+            if (!room && !growPool(needs * OS_SZ))
+                return panicOutOfMemory(); // give up
+        }
 
         objLow -= needs;
         objLow->chain = objLow + needs;
 
         // new objects are always at least ObjSlot-aligned, i.e. 8-/16-byte
         assert((uintptr_t) &objLow->vt % OS_SZ == 0);
-        return &objLow->vt;
+        return fresh(objLow);
     }
 
     void Obj::operator delete (void* p) {
@@ -140,38 +509,211 @@ namespace monty {
         auto slot = obj2slot(*(Obj*) p);
         assert(slot != nullptr);
 
+        if (slot->isRemembered())
+            forgetSlot(*slot);
+        if (gcMode == MARKING)
+            dropMark(*slot);
+        slot->chain = slot->next(); // clear all flags
+
         --objStats.coa;
         objStats.cob -= (slot->chain - slot) * OS_SZ;
 
         slot->vt = nullptr; // mark this object as free and make it unusable
 
+        if (freeListsOk) { // don't merge, that could break the free lists
+            if (slot == objLow)
+                raiseLow();
+            else
+                addFree(*slot);
+            return;
+        }
+
         mergeFreeObjs(*slot);
 
         // try to raise objLow, this will cascade when freeing during a sweep
         if (slot == objLow)
-            objLow = objLow->chain;
+            raiseLow();
+    }
+
+    // A class-specific delete can keep the slot of a deleted object, by putting
+    // a placeholder object in it, and later re-use it for a new object of the
+    // same size: this is the allocation part, i.e. new minus the slot search.
+    auto Obj::recycle (void* p) -> void* {
+        auto slot = obj2slot(*(Obj const*) p);
+        assert(slot != nullptr);
+        auto bytes = (slot->next() - slot) * OS_SZ;
+        if (allocHook != nullptr)
+            allocHook(bytes);
+
+        ++objStats.toa;
+        objStats.tob += bytes;
+
+        if (isTenured(*slot))
+            rememberSlot(*slot);
+        return fresh(slot);
     }
 
     void Obj::sweep () {
         D( printf("\tsweeping ...\n"); )
+        GcTimer timer;
+        liveBefore = objStats.cob;
         ++objStats.sweeps;
+        forgetAll(); // a full sweep leaves no young objects to remember
+        minorRun = 0;
+        dropFreeLists(); // deletes will merge, the lists are rebuilt below
         for (auto slot = objLow; slot != nullptr; slot = slot->chain)
             if (slot->isMarked())
                 slot->clearMark();
             else if (!slot->isFree()) {
                 auto q = (Obj*) &slot->vt;
                 V(*q, "\t delete");
-                delete q;
-                assert(slot->isFree());
+                delete q; // the slot stays in use if its class recycles it
             }
+
+        while (objLow->isFree() && !objLow->isLast()) {
+            mergeFreeObjs(*objLow);
+            objLow = objLow->chain;
+        }
+        for (auto slot = objLow; !slot->isLast(); slot = slot->chain)
+            if (slot->isFree()) {
+                mergeFreeObjs(*slot);
+                addFree(*slot);
+            }
+        freeListsOk = true;
+        promoteAll();
+        gcAdapt();
+    }
+
+    // a minor gc needs intact free lists, and every so often a full gc is
+    // done anyway, to reclaim old objects which have become unreachable
+    auto Obj::minorStart () -> bool {
+        if (nurseryMax == 0 || remOverflow || !freeListsOk ||
+                minorRun >= MAX_MINORS || majorDue())
+            return false;
+        ++minorRun;
+        traceRemembered(nurseryTop);
+        return true;
+    }
+
+    void Obj::markStart () {
+        assert(gcMode == STOPPED);
+        cycleMark = allocated;
+        gcMode = MARKING;
+        scanNext = nullptr;
+        grayBehind = false;
+        markPasses = 0;
+    }
+
+    auto Obj::markStep (uint32_t budget) -> bool {
+        assert(gcMode == MARKING);
+        GcTimer timer;
+        return traceMarks(budget);
+    }
+
+    void Obj::markFinish () {
+        assert(gcMode == MARKING);
+        GcTimer timer;
+        traceAllMarks();
+    }
+
+    void Obj::sweepStart () {
+        assert(gcMode == MARKING && scanNext == nullptr && markFill == 0);
+        liveBefore = objStats.cob;
+        gcMode = SWEEPING;
+        scanNext = objLow;
+    }
+
+    // like sweep, but no merging if the free lists are valid: they must stay
+    // that way, since objects will be allocated between the sweep steps
+    auto Obj::sweepStep (uint32_t budget) -> bool {
+        assert(gcMode == SWEEPING);
+        GcTimer timer;
+        uint32_t work = 0;
+        while (!scanNext->isLast()) {
+            if (work >= budget)
+                return false;
+            auto slot = scanNext;
+            work += (slot->next() - slot) * OS_SZ;
+            if (slot->isMarked())
+                slot->clearMark();
+            else if (!slot->isFree()) {
+                auto q = (Obj*) &slot->vt;
+                V(*q, "\t delete");
+                delete q; // the slot stays in use if its class recycles it
+            }
+            scanNext = slot->next(); // it may have been remembered
+        }
+
+        ++objStats.sweeps;
+        gcMode = STOPPED;
+        scanNext = nullptr;
+        if (!freeListsOk) { // lists were dropped, rebuild them as in sweep()
+            while (objLow->isFree() && !objLow->isLast()) {
+                mergeFreeObjs(*objLow);
+                objLow = objLow->chain;
+            }
+            for (auto slot = objLow; !slot->isLast(); slot = slot->chain)
+                if (slot->isFree()) {
+                    mergeFreeObjs(*slot);
+                    addFree(*slot);
+                }
+            freeListsOk = true;
+        }
+        forgetAll(); // all survivors are old now
+        minorRun = 0;
+        promoteAll();
+        cycleAlloc = allocated - cycleMark;
+        gcAdapt();
+        return true;
+    }
+
+    // no merging, the free lists must stay valid: that's left to full sweeps
+    void Obj::minorSweep () {
+        D( printf("\tminor sweep ...\n"); )
+        ++objStats.minors;
+        forgetAll();
+        sweepYoung(nurseryTop, true);
+        promoteAll();
+    }
+
+    void Obj::arenaOpen () {
+        if (arenaTop == nullptr)
+            arenaTop = objLow;
+        arenaHeld = false;
+    }
+
+    void Obj::arenaHold (bool hold) {
+        arenaHeld = hold;
+    }
+
+    // like a minor gc, but the arena gets closed, even if it can't be released
+    auto Obj::arenaStart () -> bool {
+        if (arenaTop == nullptr)
+            return false;
+        if (gcMode != STOPPED || remOverflow || !freeListsOk) {
+            arenaTop = nullptr; // it's all left to the next collection
+            return false;
+        }
+        traceRemembered(arenaTop);
+        return true;
+    }
+
+    void Obj::arenaSweep () {
+        uint32_t before = objStats.cob;
+        sweepYoung(arenaTop, false);
+        arenaTop = nullptr;
+        if (nurseryMax == 0) { // they were counted as allocated, uncount them
+            auto freed = before - objStats.cob;
+            allocated -= freed < allocated ? freed : allocated;
+        }
     }
 
     void Obj::dumpAll () {
         printf("objects: %p .. %p\n", objLow, limit);
-        for (auto slot = objLow; slot != nullptr; slot = slot->chain) {
-            if (slot->chain == 0)
+        for (auto slot = objLow; slot != nullptr; slot = slot->next()) {
+            if (slot->isLast())
                 break;
-            int bytes = (slot->chain - slot) * sizeof *slot;
+            int bytes = (slot->next() - slot) * sizeof *slot;
             printf("od: %p %6d b :", slot, bytes);
             if (slot->isFree())
                 printf(" free\n");
@@ -183,6 +725,21 @@ namespace monty {
         }
     }
 
+    void Obj::walk (void (*fun) (Obj const&, uint32_t)) {
+        for (auto slot = objLow; !slot->isLast(); slot = slot->next())
+            if (!slot->isFree())
+                fun(*(Obj const*) &slot->vt, (slot->next() - slot) * OS_SZ);
+    }
+
+    // this is a linear search, it's only intended for diagnostics
+    auto Obj::findOwner (void const* p) -> Obj const* {
+        if (inPool(p))
+            for (auto slot = objLow; !slot->isLast(); slot = slot->next())
+                if (p < slot->next())
+                    return slot->isFree() ? nullptr : (Obj const*) &slot->vt;
+        return nullptr;
+    }
+
     void objInit (void* base, size_t size) {
         assert(size > 2 * OS_SZ);
 
@@ -200,12 +757,29 @@ namespace monty {
         limit = (uintptr_t*) ((uintptr_t) base + size);
 
         assert(start < limit); // need room for at least the objLow setup
+        ++epoch;
 
         objBottom = (ObjSlot*) start;
 
         objLow = (ObjSlot*) limit - 1;
         objLow->chain = nullptr;
         objLow->vt = nullptr;
+        dropFreeLists();
+
+        nurseryTop = objLow;
+        nurseryMax = 0;
+        markFence = (ObjSlot*) limit;
+        forgetAll();
+        minorRun = 0;
+        gcMode = STOPPED;
+        scanNext = nullptr;
+        markFill = 0;
+        arenaTop = nullptr;
+
+        objStats.coa = objStats.cob = 0;
+        liveBefore = cycleAlloc = 0;
+        lastAdapt = gcClock != nullptr ? gcClock() : 0;
+        gcAdapt();
 
         //FIXME? assert((uintptr_t) &objBottom->next % OS_SZ == 0);
         assert((uintptr_t) &objLow->vt % OS_SZ == 0);
@@ -213,32 +787,94 @@ namespace monty {
         D( printf("setup: start %p limit %p\n", start, limit); )
     }
 
+    void objSpan (void*& low, void*& high) {
+        low = objLow;
+        high = limit;
+    }
+
+    // the pool now holds an image, from low up to its end: it's all old, and
+    // the free slots will be merged and indexed again in the next sweep
+    void objAdopt (void* low) {
+        assert(gcMode == STOPPED && objBottom <= low && low < limit);
+        objLow = (ObjSlot*) low;
+        dropFreeLists();
+        forgetAll();
+        minorRun = 0;
+        arenaTop = nullptr;
+        promoteAll();
+
+        objStats.coa = objStats.cob = 0;
+        for (auto slot = objLow; !slot->isLast(); slot = slot->chain) {
+            slot->chain = slot->next(); // clear all flags
+            if (!slot->isFree()) {
+                ++objStats.coa;
+                objStats.cob += (slot->chain - slot) * OS_SZ;
+            }
+        }
+        liveBefore = objStats.cob;
+        gcAdapt();
+    }
+
+    // room for this many bytes below objLow, this will grow the pool if needed
+    auto objReserve (uint32_t bytes) -> bool {
+        auto room = (uintptr_t) objLow - (uintptr_t) objBottom;
+        return room >= bytes || growPool(bytes - room);
+    }
+
+    auto objEpoch () -> uint32_t {
+        return epoch;
+    }
+
     auto gcMax () -> int {
         return (uintptr_t) objLow - (uintptr_t) objBottom;
     }
 
     auto gcCheck () -> bool {
         ++objStats.checks;
-        auto total = (intptr_t) limit - (intptr_t) start;
-        return gcMax() < total / 4; // TODO crude
+        if (nurseryMax > 0 && (nurseryTop - objLow) * OS_SZ >= nurseryMax)
+            return true; // time for a minor collection
+        return majorDue();
+    }
+
+    void gcNursery (uint32_t bytes) {
+        nurseryMax = bytes;
+    }
+
+    void remember (Obj const& obj) {
+        auto p = obj2slot(obj);
+        if (p == nullptr)
+            return;
+        if (gcMode == MARKING && p->isMarked() && !p->isGray())
+            pushMark(*p); // it may now refer to unmarked objects
+        if (isTenured(*p))
+            rememberSlot(*p);
     }
 
     void mark (Obj const& obj) {
         if (Obj::inPool(&obj)) {
             auto p = obj2slot(obj);
             if (p != nullptr) {
-                if (p->isMarked())
-                    return;
+                if (p->isMarked() || p >= markFence)
+                    return; // already marked, or old during a minor gc
                 V(obj, "\t mark");
                 p->setMark();
+                pushMark(*p);
+                if (gcMode != MARKING && !draining) { // trace everything now
+                    GcTimer timer;
+                    draining = true;
+                    traceAllMarks();
+                    draining = false;
+                }
+                return;
             }
         }
-        obj.marker();
+        obj.marker(); // not in the pool, i.e. no mark bit: always traverse
     }
 
     void objReport () {
-        printf("gc: max %d b, %d checks, %d sweeps, %d compacts\n",
-                gcMax(), objStats.checks, objStats.sweeps, objStats.compacts);
+        printf("gc: max %d b, %d checks, %d sweeps, %d minors, %d compacts\n",
+                gcMax(), objStats.checks, objStats.sweeps, objStats.minors,
+                objStats.compacts);
         printf("gc: total %6d objs %8d b, %6d vecs %8d b\n",
                 objStats.toa, objStats.tob, objStats.tva, objStats.tvb);
         printf("gc:  curr %6d objs %8d b, %6d vecs %8d b\n",
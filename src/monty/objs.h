@@ -1,5 +1,38 @@
+#ifndef ISOLATE // per-isolate state, see vecs.h
+#if NATIVE
+#define ISOLATE thread_local
+#else
+#define ISOLATE
+#endif
+#endif
+
 namespace monty {
     void objInit (void* ptr, size_t len);
+    auto gcMax () -> int; // free space between the object and vector pools
+    auto gcCheck () -> bool; // true if a collection is due
+    void gcNursery (uint32_t bytes); // nursery size, 0 disables minor gc's
+    auto objEpoch () -> uint32_t; // changes each time objInit is called
+
+    // heap images, see dash4.cpp: the pool is in use from low up to high, i.e.
+    // its end, objAdopt takes over an image copied in to end at the same spot
+    void objSpan (void*& low, void*& high);
+    void objAdopt (void* low);
+    auto objReserve (uint32_t bytes) -> bool; // make room, via objGrow if set
+
+    // tunables for the adaptive trigger of full collections, see gcCheck
+    struct GcPolicy {
+        uint8_t minFree =10;    // % of the pool, always collect below this
+        uint16_t growth =100;   // % of live data to allocate before the next gc
+        uint8_t maxCost =10;    // % of the time spent in gc, needs gcClock
+    };
+    extern ISOLATE GcPolicy gcPolicy;
+    extern auto (*gcClock) () -> uint32_t; // optional, to measure gc pauses
+
+    extern ISOLATE void (*allocHook) (uint32_t bytes); // called on each new
+
+    // optional, to let the pool grow down instead of running out of memory:
+    // returns a new, lower floor with at least the requested bytes, or null
+    extern ISOLATE auto (*objGrow) (uint32_t bytes) -> void*;
 
     struct Obj {
         Obj () =default;
@@ -14,9 +47,28 @@ namespace monty {
             return operator new (bytes + extra);
         }
         void operator delete (void*);
+        static auto recycle (void*) -> void*; // new obj in a kept obj's slot
 
         static void sweep ();   // reclaim all unmarked objects
+        static auto minorStart () -> bool; // false if a full gc is needed
+        static void minorSweep (); // reclaim unmarked young objects only
+
+        // an arena has all objects allocated since it was opened, these can
+        // be released in one step, the survivors then join the shared heap
+        static void arenaOpen ();
+        static void arenaHold (bool); // true: new objects bypass the arena
+        static auto arenaStart () -> bool; // false if it can't be released
+        static void arenaSweep (); // reclaim unmarked arena objects, and close
+
+        // incremental gc, each step does a bounded amount of work (in bytes)
+        static void markStart ();
+        static auto markStep (uint32_t budget) -> bool; // true when done
+        static void markFinish (); // trace all remaining gray objects
+        static void sweepStart ();
+        static auto sweepStep (uint32_t budget) -> bool; // true when done
         static void dumpAll (); // like sweep, but only to print all obj+free
+        static void walk (void (*) (Obj const&, uint32_t bytes)); // all objs
+        static auto findOwner (void const*) -> Obj const*; // obj containing it
 
         // "Rule of 5"
         Obj (Obj&&) =delete;
@@ -27,4 +79,6 @@ namespace monty {
 
     void mark (Obj const&);
     inline void mark (Obj const* p) { if (p != nullptr) mark(*p); }
+
+    void remember (Obj const&); // write barrier: obj may now ref young objs
 }
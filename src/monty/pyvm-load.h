@@ -61,9 +61,33 @@ struct Bytecode : List, CodePrefix {
     static Type info;
     auto type () const -> Type const& override { return info; }
 
-    auto base () const -> uint8_t const* { return (uint8_t const*) (this+1); }
+    // code executed in place stays where it is, e.g. in flash or in an mmap'ed
+    // file, and has module-local qstr indices: their ids are in the root's map
+    // note: heap images refer to such code, so they refuse to save it
+    uint8_t const* _xip {nullptr};
+    Bytecode const* _root {nullptr};
+
+    auto base () const -> uint8_t const* {
+        return _xip != nullptr ? _xip : (uint8_t const*) (this+1);
+    }
     auto start () const -> uint8_t const* { return base() + code; }
 
+    // map a qstr operand in the code to its qstr id
+    auto qstrAt (uint16_t n) const -> Q {
+        if (_root == nullptr)
+            return n + 1;
+        return ((uint16_t const*) (_root + 1))[n];
+    }
+
+    void marker () const override { List::marker(); mark(_root); }
+
+    // the code follows this object, and a root's qstr map follows its code,
+    // unless it's executed in place: then it's not in the heap at all
+    auto rawData (uint32_t& n) const -> void const* override {
+        n = ~0U; // i.e. up to the end of the object slot
+        return base();
+    }
+
     // determine the source line number, given an offset into the bytecode
     auto findLine (uint32_t off) const -> uint32_t {
         uint32_t line = 1;
@@ -91,14 +115,15 @@ struct Bytecode : List, CodePrefix {
         int i = k;
         if (i >= 0)
             return findLine(i);
-        auto p = reinterpret_cast<uint16_t const*>(base());
+        auto p = base();
         // index with -1 or -2 to obtain the file/function names, respectively
         if (i == -1)
-            ++p;
-        return Q(*p+1); // return first or second qstr in the bytecode body
+            p += 2;
+        return qstrAt(p[0] | (p[1] << 8)); // first or second qstr in the body
     }
 
     static auto load (void const*, Value) -> Callable*;
+    static auto convert (void const*, void (*) (void const*, uint32_t)) -> bool;
 
     friend struct Loader;
 };
@@ -114,7 +139,12 @@ struct Loader {
     ByteVec constData;      // convert: all collected const data
     uint16_t constNext {0}; // convert: index of next unused const entry
 
+    ByteVec* xout {nullptr};    // in-place: code in the XIP format, else 0
+    VecOf<uint16_t> xqs;        // in-place: ids of all module-local qstrs
+    uint8_t const* xbase;       // in-place: start of the XIP data
+
     Loader (VaryVec* vv =nullptr) : vvec (vv) {}
+    Loader (ByteVec* xo) : vvec (nullptr), xout (xo) {}
 
     Callable* load (uint8_t const* data, Value nm) {
         assert(data != nullptr);
@@ -129,8 +159,20 @@ struct Loader {
         debugf("qwin %d\n", n);
         qWin.insert(0, n); // qstr window
 
+        if (xout != nullptr)
+            xput(nullptr, 8); // magic and qstr table offset, filled in below
+
         auto& bc = loadRaw();
 
+        if (xout != nullptr) {
+            uint32_t off = xout->size();
+            xvar(xqs.size());
+            for (auto id : xqs)
+                xput(Q::str(id), strlen(Q::str(id)) + 1);
+            memcpy(xout->begin(), "X\0\0\0", 4);
+            memcpy(xout->begin() + 4, &off, 4);
+        }
+
         if (vvec != nullptr) {
             auto n = vvec->size();
             vvec->insert(n, 2);
@@ -221,6 +263,8 @@ struct Loader {
     int storeQstr () {
         auto n = loadQstr();
         assert(n > 0);
+        if (xout != nullptr)
+            n = xipQstr(n) + 1;
         *bcNext++ = --n;
         *bcNext++ = n >> 8;
         return n;
@@ -261,6 +305,17 @@ struct Loader {
         auto nCode = varInt();
         debugf("nData %d nCode %d\n", nData, nCode);
 
+        if (xout != nullptr) {
+            CodePrefix pfx = bc;
+            xalign();
+            xput(&pfx, sizeof pfx);
+            xvar(bcNext - bcBuf);
+            xalign();
+            xput(bcBuf, bcNext - bcBuf);
+            xvar(nData);
+            xvar(nCode);
+        }
+
         if (vvec != nullptr) {
             CodePrefix pfx = bc; // new bytecode prefix when converting
             pfx.constOff = constNext;
@@ -282,36 +337,15 @@ struct Loader {
             auto qs = loadQstr();
             debugf("bc %d qs %d: %s\n", bc.size(), qs, Q::str(qs));
             bc.append(Q(qs));
+            if (xout != nullptr)
+                xvar(xipQstr(qs));
         }
 
         for (uint32_t i = 0; i < nData; ++i) {
-            auto type = *dp++;
-            (void) type;
-            if (type == 'e') {
-                bc.append({}); // TODO ellipsis
-                continue;
-            }
-            auto sz = varInt();
-            auto ptr = skip(sz);
-            if (type == 'b') {
-                auto p = new (sz) Bytes (ptr, sz);
-                debugf("  obj %d = type %c %db @ %p\n", i, type, sz, p);
-                bc.append(p);
-            } else if (type == 's') {
-                auto p = new Str ((char const*) ptr, sz);
-                debugf("  obj %d = type %c %db = %s\n",
-                        i, type, sz, (char const*) *p);
-                bc.append(p);
-            } else if (type == 'i') {
-                assert(sz < 25);
-                char buf [25];
-                memcpy(buf, ptr, sz);
-                buf[sz] = 0;
-                bc.append(Int::conv(buf));
-            } else {
-                //assert(false); // TODO f)loat and c)omplex
-                bc.append(new (sz) Bytes (ptr,sz));
-            }
+            auto savedDp = dp;
+            loadConst(bc);
+            if (xout != nullptr)
+                xput(savedDp, dp - savedDp);
         }
 
         if (vvec != nullptr) {
@@ -339,6 +373,34 @@ struct Loader {
         return bc;
     }
 
+    void loadConst (Bytecode& bc) {
+        auto type = *dp++;
+        if (type == 'e') {
+            bc.append({}); // TODO ellipsis
+            return;
+        }
+        auto sz = varInt();
+        auto ptr = skip(sz);
+        if (type == 'b') {
+            auto p = new (sz) Bytes (ptr, sz);
+            debugf("  obj type %c %db @ %p\n", type, sz, p);
+            bc.append(p);
+        } else if (type == 's') {
+            auto p = new Str ((char const*) ptr, sz);
+            debugf("  obj type %c %db = %s\n", type, sz, (char const*) *p);
+            bc.append(p);
+        } else if (type == 'i') {
+            assert(sz < 25);
+            char buf [25];
+            memcpy(buf, ptr, sz);
+            buf[sz] = 0;
+            bc.append(Int::conv(buf));
+        } else {
+            //assert(false); // TODO f)loat and c)omplex
+            bc.append(new (sz) Bytes (ptr,sz));
+        }
+    }
+
     void loadOps () {
         constexpr auto MP_BC_MASK_EXTRA_BYTE = 0x9e;
         constexpr auto MP_BC_FORMAT_BYTE     = 0;
@@ -386,9 +448,124 @@ struct Loader {
             }
         }
     }
+
+    // The XIP format is a translated .mpy file, meant to be used in place:
+    //  "X\0\0\0", 32-bit offset of the qstr table, the root's code block
+    //  code block: prefix, varint len, (even) code, varint nData & nCode,
+    //      nPos+nKwo varint qstr indices, nData consts as in .mpy, nCode blocks
+    //  qstr table: varint count, null-terminated strings
+    // All qstr operands in the code are indices into the qstr table.
+
+    static auto isXip (uint8_t const* p) -> bool {
+        return p[0] == 'X' && p[1] == 0 && p[2] == 0 && p[3] == 0;
+    }
+
+    auto xipQstr (uint16_t id) -> uint16_t {
+        auto n = xqs.find(id);
+        if (n >= xqs.size())
+            xqs.append(id);
+        return n;
+    }
+
+    void xput (void const* ptr, uint32_t len) {
+        auto n = xout->size();
+        xout->insert(n, len);
+        if (ptr != nullptr)
+            memcpy(xout->begin() + n, ptr, len);
+    }
+
+    void xalign () {
+        if (xout->size() & 1)
+            xput(nullptr, 1);
+    }
+
+    void xvar (uint32_t v) {
+        uint8_t buf [5];
+        int n = sizeof buf;
+        buf[--n] = v & 0x7F;
+        while ((v >>= 7) != 0)
+            buf[--n] = v | 0x80;
+        xput(buf + n, sizeof buf - n);
+    }
+
+    void xskip () {
+        if ((dp - xbase) & 1)
+            ++dp;
+    }
+
+    Callable* loadXip (uint8_t const* data, Value nm) {
+        xbase = dp = data;
+        if (!isXip(dp))
+            return 0; // incorrect file format
+
+        uint32_t off;
+        memcpy(&off, data + 4, 4);
+        dp += 8;
+        auto& bc = xipRaw(data + off, nullptr);
+
+        auto mod = new Module (nm);
+        return new Callable (bc, mod);
+    }
+
+    Bytecode const& xipRaw (uint8_t const* qtab, Bytecode const* root) {
+        xskip();
+        CodePrefix pfx;
+        memcpy(&pfx, dp, sizeof pfx);
+        dp += sizeof pfx;
+
+        Bytecode* bc;
+        if (root == nullptr) {
+            // the root has the module's qstr map in extra bytes
+            auto savedDp = dp;
+            dp = qtab;
+            auto nq = varInt();
+            bc = new (2 * nq) Bytecode;
+            auto map = (uint16_t*) (bc + 1);
+            for (uint32_t i = 0; i < nq; ++i) {
+                auto s = (char const*) dp;
+                map[i] = Q::make(s);
+                dp += strlen(s) + 1;
+            }
+            dp = savedDp;
+            root = bc;
+        } else
+            bc = new Bytecode;
+
+        (CodePrefix&) *bc = pfx;
+        bc->_root = root;
+        auto len = varInt();
+        xskip();
+        bc->_xip = skip(len);
+
+        auto nData = varInt();
+        auto nCode = varInt();
+        debugf("xip len %d nData %d nCode %d\n", len, nData, nCode);
+
+        bc->adj(bc->nPos + bc->nKwo + nData + nCode); // pre-alloc
+        for (int i = 0; i < bc->nPos + bc->nKwo; ++i)
+            bc->append(root->qstrAt(varInt()));
+        for (uint32_t i = 0; i < nData; ++i)
+            loadConst(*bc);
+        for (uint32_t i = 0; i < nCode; ++i)
+            bc->append(xipRaw(qtab, root));
+
+        return *bc;
+    }
 };
 
 auto Bytecode::load (void const* p, Value name) -> Callable* {
     Loader loader;
+    if (Loader::isXip((uint8_t const*) p))
+        return loader.loadXip((uint8_t const*) p, name);
     return loader.load((uint8_t const*) p, name);
 }
+
+// translate a .mpy file to the XIP format, which can then be used in place
+auto Bytecode::convert (void const* p, void (*out) (void const*, uint32_t)) -> bool {
+    ByteVec buf;
+    Loader loader (&buf);
+    if (loader.load((uint8_t const*) p, Q(0,"__main__")) == nullptr)
+        return false;
+    out(buf.begin(), buf.size());
+    return true;
+}
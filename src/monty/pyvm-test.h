@@ -11,3 +11,138 @@ TEST_CASE("pyvm") {
     Vec::compact();
     //FIXME CHECK(memAvail == gcMax());
 }
+
+static uint8_t xipData [200];
+static uint32_t xipFill;
+
+static void xipWrite (void const* p, uint32_t n) {
+    assert(xipFill + n <= sizeof xipData);
+    memcpy(xipData + xipFill, p, n);
+    xipFill += n;
+}
+
+TEST_CASE("execute in place") {
+    uint8_t memory [8*1024];
+    vecInit(memory, 4*1024);
+    objInit(memory + 4*1024, 4*1024);
+    Module::loaded._chain = &Module::builtins; // as set up in qstr.cpp
+    Module::builtins.at("modules") = Module::loaded; // as in the sys module
+
+    // hand-made .mpy for "x = 1" (v5, module <module>, file t.py)
+    static uint8_t const mpy [] = {
+        'M', 5, 0, 31, 2,                   // header, qstr window size
+        13<<2, 0x00, 5<<1,                  // size, prelude
+        8<<1, '<','m','o','d','u','l','e','>',  4<<1, 't','.','p','y',
+        0,                                  // line info
+        0x81, 0x16, 1<<1, 'x', 0x51, 0x63,  // 1, store x, None, return
+        0, 0,                               // no consts, no children
+    };
+
+    xipFill = 0;
+    CHECK(Bytecode::convert(mpy, xipWrite));
+    CHECK(xipData[0] == 'X');
+
+    uint8_t const* inputs [] = { mpy, xipData };
+    for (auto data : inputs) {
+        auto init = Bytecode::load(data, Q(0,"__main__"));
+        REQUIRE(init != nullptr);
+        auto& bc = init->_bc;
+        CHECK((bc._xip != nullptr) == (data == xipData));
+        CHECK(bc.sTop == 1);
+        CHECK(strcmp(bc.getAt(-1), "t.py") == 0);
+        CHECK(strcmp(bc.getAt(-2), "<module>") == 0);
+
+        auto p = bc.start();
+        CHECK(p[0] == 0x81);
+        CHECK(p[1] == 0x16);
+        Value q = bc.qstrAt(p[2] | (p[3] << 8));
+        CHECK(strcmp(q, "x") == 0);
+        CHECK(p[4] == 0x51);
+
+        Module::loaded.at("t") = init;
+        Context::gcAll(); // the root with the qstr map stays alive
+        CHECK(strcmp(bc.getAt(-2), "<module>") == 0);
+    }
+
+    Module::loaded.clear();
+    Module::builtins.clear();
+    Context::gcAll();
+    qstrCleanup();
+}
+
+// a built-in which needs results from a key function, which may be bytecode
+static Function const sortIt ([](ArgVec const& args) -> Value {
+    auto v = sortVec(args[0].asType<List>(), args[1]);
+    return v.isNil() ? args[0] : v;
+});
+
+TEST_CASE("nested calls") {
+    uint8_t memory [8*1024];
+    vecInit(memory, 4*1024);
+    objInit(memory + 4*1024, 4*1024);
+    Module::loaded._chain = &Module::builtins; // as set up in qstr.cpp
+    Module::builtins.at("modules") = Module::loaded; // as in the sys module
+
+    // hand-made .mpy for "def f(x): return -x" and "r = sort(l, f)"
+    static uint8_t const mpy [] = {
+        'M', 5, 0, 31, 2,                   // header, qstr window size
+        28<<2, 0x10, 5<<1,                  // size, prelude
+        8<<1, '<','m','o','d','u','l','e','>',  4<<1, 't','.','p','y',
+        0,                                  // line info
+        0x32, 0,  0x16, 1<<1, 'f',          // make function, store f
+        0x11, 4<<1, 's','o','r','t',        // load sort
+        0x11, 1<<1, 'l',  0x11, 1<<1, 'f',  // load l, load f
+        0x34, 2,  0x16, 1<<1, 'r',          // call with 2 args, store r
+        0x51, 0x63,                         // None, return
+        0, 1,                               // no consts, one child
+        10<<2, 0x09, 5<<1,                  // size, prelude: 1 pos arg
+        1<<1, 'f',  4<<1, 't','.','p','y',
+        0,                                  // line info
+        0xB0, 0xD0 + UnOp::Neg, 0x63,       // load x, negate, return
+        0, 0,                               // no consts, no children
+        1<<1, 'x',                          // arg name
+    };
+    constexpr auto NEG_OP = sizeof mpy - 6; // the op to patch, see below
+
+    uint8_t code [sizeof mpy];
+    memcpy(code, mpy, sizeof mpy);
+    for (int pass = 0; pass < 2; ++pass) {
+        auto init = Bytecode::load(code, Q(0,"__main__"));
+        REQUIRE(init != nullptr);
+        auto& mo = init->_mo;
+        auto l = new List;
+        if (pass == 0)
+            l->append(3);
+        else
+            l->append(Exception::create(E::ValueError, {}));
+        l->append(-1);
+        l->append(2);
+        mo.at("l") = l;
+        mo.at("sort") = sortIt;
+        Module::loaded.at("t") = mo;
+
+        Context::current = new PyVM (*init);
+        Context::current->run(); // until the module code is done
+        CHECK(Context::current == nullptr);
+
+        if (pass == 0) { // sorted on the negated values, i.e. in reverse
+            Value r = mo.at("r");
+            REQUIRE(r.isObj());
+            CHECK(&r.obj() == l);
+            CHECK((int) (*l)[0] == 3);
+            CHECK((int) (*l)[1] == 2);
+            CHECK((int) (*l)[2] == -1);
+            code[NEG_OP] = 0x65; // raise x, instead of returning -x
+        } else { // the key raised, the sort stopped and the list is unchanged
+            Value r = mo.at("r");
+            CHECK(r.isNil());
+            CHECK((int) (*l)[1] == -1);
+            CHECK((int) (*l)[2] == 2);
+        }
+    }
+
+    Module::loaded.clear();
+    Module::builtins.clear();
+    Context::gcAll();
+    qstrCleanup();
+}
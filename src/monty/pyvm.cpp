@@ -141,6 +141,10 @@ struct Cell : Object {
 
     void marker () const override { _val.marker(); }
 
+    auto operator new (size_t bytes) -> void* { return cache.take(bytes); }
+    void operator delete (void* p, size_t bytes) { cache.give(p, bytes); }
+    static ISOLATE Recycler cache;
+
     Value _val;
 };
 
@@ -158,6 +162,10 @@ struct BoundMeth : Object {
     }
 
     void marker () const override { mark(_meth); _self.marker(); }
+
+    auto operator new (size_t bytes) -> void* { return cache.take(bytes); }
+    void operator delete (void* p, size_t bytes) { cache.give(p, bytes); }
+    static ISOLATE Recycler cache;
 private:
     Object const& _meth;
     Value _self;
@@ -224,6 +232,11 @@ struct PyVM : Context {
     static constexpr auto FinallyFlag = 1U<<20;
     static constexpr auto FinallyMask = FinallyFlag - 1;
 
+    // specialised for-loop states, tagged in the 4th stack entry, see opForIter
+    static constexpr int ITER_RANGE = 1; // layout [to,from,by,tag]
+    static constexpr int ITER_VEC = 2;   // layout [seq,idx,nil,tag]
+    static constexpr int ITER_ITEMS = 3; // layout [dict,idx,nil,tag]
+
     auto globals () const -> Module& { return _callee->_mo; }
 
     void marker () const override {
@@ -232,10 +245,18 @@ struct PyVM : Context {
         _signal.marker();
     }
 
+    auto allocSite (uint32_t& off) const -> Object const* override {
+        if (_callee == nullptr)
+            return nullptr;
+        off = _ip - ipBase();
+        return &_callee->_bc;
+    }
+
     // previous values are saved in current stack frame
     uint16_t _base = 0;
     uint16_t _spOff = 0;
     uint16_t _ipOff = 0;
+    int _stop = -1; // the frame which a nested call returns to, see nested()
     Callable const* _callee = nullptr;
 
     Value _signal;
@@ -267,7 +288,7 @@ struct PyVM : Context {
     }
 
     auto fetchQ () -> Q {
-        return fetchO() + 1; // TODO get rid of this off-by-one stuff
+        return _callee->_bc.qstrAt(fetchO()); // also maps in-place qstrs
     }
 
     // special wrapper to deal with context changes vs cached sp/ip values
@@ -486,7 +507,7 @@ struct PyVM : Context {
     //CG1 op v
     void opBuildTuple (int arg) {
         _sp -= arg - 1;
-        *_sp = new Tuple ({*this, arg, (int) (_sp - begin())});
+        *_sp = Tuple::make({*this, arg, (int) (_sp - begin())});
     }
     //CG1 op v
     void opBuildList (int arg) {
@@ -698,6 +719,7 @@ struct PyVM : Context {
     }
     //CG1 op v
     void opStoreDeref (int arg) {
+        remember(fastSlot(arg).obj()); // the cell may be older than the value
         derefSlot(arg) = *_sp--;
     }
     //CG1 op v
@@ -735,13 +757,67 @@ struct PyVM : Context {
     void opGetIterStack () {
         // hard-coded to use 4 entries, layout [seq,(idx|iter),nil,nil]
         static_assert(sizeof (RawIter) == 3 * sizeof *_sp, "RawIter size?");
-        (RawIter&) *_sp = {_sp->asObj()}; // may need to convert, e.g. qstrs
+        auto& seq = _sp->asObj(); // may need to convert, e.g. qstrs
+        auto& t = seq.type();
+        if (&t == &Range::info) {
+            auto& r = (Range&) seq;
+            _sp[0] = r._to;
+            _sp[1] = r._from;
+            _sp[2] = r._by;
+            _sp[3] = ITER_RANGE;
+        } else if (&t == &List::info || &t == &Tuple::info ||
+                    &t == &Dict::info || &t == &Set::info) {
+            _sp[0] = seq; // for dicts and sets, this iterates over the keys
+            _sp[1] = 0;
+            _sp[2] = {};
+            _sp[3] = ITER_VEC;
+        } else if (&t == &DictView::info && ((DictView&) seq)._vtype != 1) {
+            auto& dv = (DictView&) seq;
+            _sp[0] = dv._dict;
+            _sp[1] = 0;
+            _sp[2] = {};
+            _sp[3] = dv._vtype == 0 ? ITER_VEC : ITER_ITEMS;
+        } else {
+            (RawIter&) *_sp = {seq};
+            _sp[3] = {};
+        }
         _sp += 3;
-        *_sp = {};
     }
     //CG1 op o
     void opForIter (int arg) {
-        Value v = ((RawIter&) _sp[-3]).stepper();
+        Value v;
+        if (_sp->isNil())
+            v = ((RawIter&) _sp[-3]).stepper();
+        else if ((int) *_sp == ITER_RANGE) {
+            int pos = _sp[-2], by = _sp[-1];
+            if (by > 0 ? pos < (int) _sp[-3] : pos > (int) _sp[-3]) {
+                v = _sp[-2];
+                _sp[-2] = pos + by;
+            }
+        } else if ((int) *_sp == ITER_VEC) {
+            auto& vec = (Tuple&) _sp[-3].obj();
+            uint32_t idx = _sp[-2];
+            if (idx < vec._fill) {
+                v = vec[idx];
+                _sp[-2] = idx + 1;
+            }
+        } else {
+            auto& d = (Dict&) _sp[-3].obj();
+            uint32_t idx = _sp[-2];
+            if (idx < d._fill) {
+                _sp[-2] = idx + 1;
+                // "for k, v in d.items()": push both, skip the unpack
+                if (_ip[0] == UnpackSequence && _ip[1] == 2) {
+                    _ip += 2;
+                    _sp[1] = d[idx+d._fill];
+                    _sp[2] = d[idx];
+                    _sp += 2;
+                    return;
+                }
+                Value args [] = {d[idx], d[idx+d._fill]};
+                v = Tuple::make({args});
+            }
+        }
         if (v.isOk())
             *++_sp = v;
         else {
@@ -863,6 +939,8 @@ struct PyVM : Context {
             _callee = &f.callee.asType<Callable>(); // restore callee
             remove(_base, _fill - _base); // delete current frame
             _base = prev;           // new lower frame offset
+            if (_base == _stop)
+                setPending(0);      // back to nested(), exit the inner loop
         } else {
             _fill = 0;              // last frame gone, delete stack
             adj(0);                 // ... and release entire vector
@@ -916,17 +994,53 @@ struct PyVM : Context {
     }
 
     auto run () -> bool override {
-        while (current == this) {
-            inner();
-            //FIXME!!!
-            ///if ((pending & (1<<0)) && gcCheck())
-            ///    gcAll();
-        }
+        while (current == this)
+            inner(); // gc is triggered between tasks, see Context::runLoop
         return false;
     }
 
     auto next () -> Value override { return send(); }
 
+    // Run a call inside the current instruction, i.e. also when it enters a
+    // bytecode frame: that frame runs until it returns, or an exception gets
+    // past it. It can't suspend the task, e.g. to wait for an event. Pending
+    // triggers are set aside meanwhile, and restored once the call is done.
+    auto nested (Value f, ArgVec const& args, Value& res) -> bool override {
+        auto base = _base;
+        auto stop = _stop;
+        auto spOff = _spOff;
+        auto keep = begin()[spOff]; // a return will store its result here
+        auto flags = clearAllPending();
+
+        _stop = base;
+        res = f->call(args);
+        auto entered = _base != base;
+        while (_base != base) {
+            if (_signal.isOk())
+                caught(); // unwind, possibly all the way back to this call
+            else
+                inner();
+            assert(current == this);
+            flags |= clearAllPending() & ~1U; // bit 0 is the exit from inner
+        }
+        _stop = stop;
+
+        if (entered) {
+            if (res.isNil())
+                res = begin()[spOff];
+            begin()[spOff] = keep;
+        }
+        auto ok = _signal.isNil();
+        if (!ok) {
+            res = _signal; // it stays pending, to be raised in the VM
+            flags |= 1;
+        }
+        for (int i = 0; flags != 0; ++i, flags >>= 1)
+            if (flags & 1)
+                setPending(i);
+        return ok;
+    }
+
     //CG: wrap PyVM send
     auto send (Value arg =Null) -> Value {
         assert(_fill != 0);
@@ -1073,24 +1187,28 @@ Type      Cell::info (Q(0,"<cell>"));
 Type BoundMeth::info (Q(0,"<boundmeth>"));
 Type   Closure::info (Q(0,"<closure>"));
 
+ISOLATE Recycler      Cell::cache (sizeof (Cell));
+ISOLATE Recycler BoundMeth::cache (sizeof (BoundMeth));
+
 //CG: wrappers PyVM
 
 Type PyVM::info (Q(0,"<pyvm>"), &PyVM::attrs);
 
+// data is a module name, or else the module's code, in .mpy or XIP format
 auto monty::vmLaunch (void const* data) -> Context* {
     if (data == nullptr)
         return nullptr;
-    auto init = Bytecode::load(data, Q(0,"__main__"));
-    if (init == nullptr) {
-        auto mpy = vmImport((char const*) data);
-        if (mpy != nullptr)
-            init = Bytecode::load(mpy, Q(0,"__main__"));
-        if (init == nullptr)
-            return nullptr;
-    }
+    auto mpy = vmImport((char const*) data); // names are looked up first
+    auto init = Bytecode::load(mpy != nullptr ? mpy : data, Q(0,"__main__"));
+    if (init == nullptr)
+        return nullptr;
     return new PyVM (*init);
 }
 
+auto monty::vmConvert (void const* data, void (*out) (void const*, uint32_t)) -> bool {
+    return data != nullptr && Bytecode::convert(data, out);
+}
+
 #if DOCTEST
 #include <doctest.h>
 namespace {
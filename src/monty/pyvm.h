@@ -1,4 +1,6 @@
 namespace monty {
     auto vmImport (char const* name) -> uint8_t const*;
     auto vmLaunch (void const* data) -> Context*;
+    // translate a .mpy file to a form which can run in place, see vmLaunch
+    auto vmConvert (void const* data, void (*out) (void const*, uint32_t)) -> bool;
 }
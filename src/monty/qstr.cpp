@@ -12,7 +12,7 @@ static Lookup::Item const mod_map [] = {
 };
 
 static Lookup const mod_attrs (mod_map);
-Dict Module::loaded (&mod_attrs);
+ISOLATE Dict Module::loaded (&mod_attrs);
 
 extern char const monty::qstrBase [] =
 //CG: qstr-emit
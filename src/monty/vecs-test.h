@@ -107,6 +107,159 @@ TEST_CASE("Vec allocate") {
         v.adj(0);
     }
 
+    SUBCASE("best fit") {
+        Vec v1, v2, v3, v4, w1, w2;
+        v1.adj(100);    // 7 slots
+        v2.adj(10);     // 2 slots
+        v3.adj(30);     // 3 slots
+        v4.adj(10);     // 2 slots
+        auto p1 = v1.ptr(), p3 = v3.ptr();
+        auto high = vecHigh;
+
+        v3.adj(0);
+        v1.adj(0);      // [ gap:7 v2 gap:3 v4 ]
+
+        w1.adj(30);     // first fit would split the first gap
+        CHECK(w1.ptr() == p3);
+        w2.adj(50);     // 4 slots, splits the first gap
+        CHECK(w2.ptr() == p1);
+        v1.adj(30);     // uses the remaining 3 slots
+        CHECK(v1.ptr() > p1);
+        CHECK(v1.ptr() < v2.ptr());
+        CHECK(vecHigh == high);
+
+        v2.adj(40);     // can't grow in place, moves, leaves a 2-slot gap
+        CHECK(vecHigh > high);
+        v3.adj(10);
+        CHECK(v3.ptr() < v4.ptr()); // in the gap left by v2
+        CHECK(v3.ptr() > v1.ptr());
+
+        Vec* all [] = { &v1, &v2, &v3, &v4, &w1, &w2 };
+        for (auto v : all)
+            v->adj(0);
+    }
+
+    SUBCASE("walk") {
+        Vec v1, v2, v3;
+        v1.adj(100);    // 7 slots
+        v2.adj(10);     // 2 slots
+        v3.adj(30);     // 3 slots
+        v2.adj(0);
+
+        static Vec const* seen [3];
+        static uint32_t total, count;
+        total = count = 0;
+        Vec::walk([](Vec const& v, uint32_t bytes) {
+            seen[count++] = &v;
+            total += bytes;
+        });
+        CHECK(count == 2);
+        CHECK(seen[0] == &v1);
+        CHECK(seen[1] == &v3);
+        CHECK(total == 10 * VSZ);
+
+        v1.adj(0);
+        v3.adj(0);
+    }
+
+    SUBCASE("compact in steps") {
+        Vec v [8];
+        for (int i = 0; i < 8; ++i) {
+            v[i].adj(20 + 10 * i);
+            memset(v[i].ptr(), i, v[i].cap());
+        }
+        for (int i = 0; i < 8; i += 2)
+            v[i].adj(0);    // [ gap v1 gap v3 gap v5 gap v7 ]
+        auto high = vecHigh;
+
+        auto steps = 1;
+        while (!Vec::compactStep(60)) {
+            ++steps;
+            v[3].adj(v[3].cap() + 1); // resizing in between is allowed
+        }
+        CHECK(steps > 2);
+        CHECK(vecHigh < high);
+        CHECK(v[1].ptr() == vecLow->payload());
+        for (int i = 1; i < 8; i += 2)
+            CHECK(v[i].ptr()[0] == i);
+
+        for (int i = 1; i < 8; i += 2)
+            v[i].adj(0);
+    }
+
+    Vec::compact();
+    CHECK(vecHigh == vecLow);
+}
+
+TEST_CASE("Vec fragmentation") {
+    uint8_t mem [4000];
+    vecInit(mem, sizeof mem);
+
+    Vec v [64];
+    for (auto& e : v)
+        e.adj(2*VSZ - PSZ); // exactly two slots each
+    auto high = vecHigh;
+    auto p1 = v[1].ptr();
+
+    v[0].adj(0);            // one small gap at the start
+    for (int i = 32; i < 64; i += 2)
+        v[i].adj(0);        // lots of gaps in the second half
+
+    vecFragLevel(20);
+    CHECK(vecCheck());
+    vecFragLevel(40);
+    CHECK(!vecCheck());     // 34 out of 128 slots is not enough
+
+    auto steps = 1;
+    while (!Vec::compactStep(VSZ))
+        ++steps;            // each step looks at one window, or moves one vec
+    CHECK(steps > 17);
+    CHECK(v[1].ptr() == p1);                // first window has been skipped
+    CHECK(v[33].ptr() == (vecLow + 64)->payload());
+    CHECK(vecHigh == high - 32);
+
+    vecFragLevel(0);
+    CHECK(vecCheck());
+    CHECK(Vec::compactStep(~0U));
+    CHECK(v[1].ptr() == vecLow->payload()); // now it's fully compacted
+    CHECK(vecHigh == high - 34);
+    CHECK(!vecCheck());
+
+    for (auto& e : v)
+        e.adj(0);
+    Vec::compact();
+    CHECK(vecHigh == vecLow);
+}
+
+static uint8_t *growEnd, *growTop; // the test pool can grow up to end
+
+TEST_CASE("Vec grow") {
+    uint8_t mem [2000];
+    growEnd = mem + sizeof mem;
+    growTop = mem + 200;
+    vecInit(mem, 200);
+
+    vecGrow = [](uint32_t bytes) -> void* {
+        if (growTop + bytes > growEnd)
+            return nullptr;
+        growTop += bytes;
+        return growTop;
+    };
+
+    Vec v1, v2;
+    CHECK(v1.adj(500));                 // too large for the initial pool
+    CHECK(vecTop > mem + 500);
+    CHECK(vecTop <= growTop);
+    CHECK((uintptr_t) vecTop % VSZ == PSZ);
+
+    CHECK(v2.adj(100));
+    CHECK(v2.adj(800));                 // at the end, so it's resized in place
+    CHECK(v2.ptr() > v1.ptr());
+    CHECK(vecTop > v2.ptr() + 800);
+
+    vecGrow = nullptr;
+    v1.adj(0);
+    v2.adj(0);
     Vec::compact();
     CHECK(vecHigh == vecLow);
 }
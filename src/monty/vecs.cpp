@@ -7,9 +7,10 @@
 
 using namespace monty;
 
-VecSlot *monty::vecLow;
-VecSlot *monty::vecHigh;
-uint8_t* monty::vecTop;
+ISOLATE VecSlot *monty::vecLow;
+ISOLATE VecSlot *monty::vecHigh;
+ISOLATE uint8_t* monty::vecTop;
+ISOLATE auto (*monty::vecGrow) (uint32_t bytes) -> void*;
 
 struct monty::VecSlot {
     auto isFree () const -> bool { return owner == nullptr; }
@@ -27,6 +28,101 @@ static auto numVecSlots (size_t n) {
     return (n + VSZ - 1) / VSZ;
 }
 
+// ask for room above the pool, up to end, this only succeeds if vecGrow is set
+static auto growPool (void const* end) -> bool {
+    auto need = (uintptr_t) end - (uintptr_t) vecTop;
+    auto top = vecGrow != nullptr ? (uint8_t*) vecGrow(need + VSZ) : nullptr;
+    if (top != nullptr) {
+        top -= ((uintptr_t) top - PSZ) % VSZ; // same alignment as in vecInit
+        if (top > vecTop)
+            vecTop = top;
+    }
+    return (uintptr_t) end <= (uintptr_t) vecTop;
+}
+
+// Free vecs of 2 or more slots are indexed: they are on doubly-linked lists,
+// one per power-of-2 size range, with the links stored in their second slot.
+// Every change to a free vec's extent must drop it from the index and re-add.
+// Single-slot free vecs are not indexed, they are only found by a full scan.
+
+struct FreeLinks { VecSlot* prev; VecSlot* next; };
+
+constexpr auto NUM_BINS = 24;
+static ISOLATE VecSlot* freeBins [NUM_BINS];
+
+static auto binOf (uint32_t n) -> int {
+    int b = 31 - __builtin_clz(n);
+    return b < NUM_BINS ? b : NUM_BINS - 1;
+}
+
+static auto links (VecSlot& slot) -> FreeLinks& {
+    return *(FreeLinks*) (&slot + 1);
+}
+
+static void addFree (VecSlot& slot) {
+    uint32_t n = slot.next - &slot;
+    if (n > 1) {
+        auto& head = freeBins[binOf(n)];
+        links(slot) = {nullptr, head};
+        if (head != nullptr)
+            links(*head).prev = &slot;
+        head = &slot;
+    }
+}
+
+static void dropFree (VecSlot& slot) {
+    uint32_t n = slot.next - &slot;
+    if (n > 1) {
+        auto& l = links(slot);
+        if (l.prev != nullptr)
+            links(*l.prev).next = l.next;
+        else
+            freeBins[binOf(n)] = l.next;
+        if (l.next != nullptr)
+            links(*l.next).prev = l.prev;
+    }
+}
+
+// Incremental compaction works on one window of the pool at a time, picking
+// the one with the most free space which can be squeezed out. It then moves
+// one vec at a time, and keeps a cursor between steps. Everything in the
+// window below the cursor has been compacted. The cursor must stay on a vec
+// boundary, so when its vec gets absorbed, it moves down to the vec which
+// absorbed it (any lower boundary is fine, it just means more scanning).
+// The end of the window is only used as a limit, it need not be a boundary.
+// The search for a window is also done in steps, with a cursor of its own.
+constexpr auto WINDOW = 64; // in vec slots
+static ISOLATE VecSlot* compactNext;
+static ISOLATE VecSlot* compactEnd;
+static ISOLATE VecSlot* pickNext;   // where the window search resumes
+static ISOLATE VecSlot* pickStart;  // the best window found so far
+static ISOLATE VecSlot* pickEnd;
+static ISOLATE uint32_t pickBest;
+static ISOLATE uint32_t vecUsed;    // slots in use by vecs
+static ISOLATE uint8_t fragLevel;   // % of free space which needs compaction
+
+static void clearFree () {
+    for (auto& e : freeBins)
+        e = nullptr;
+}
+
+// smallest indexed free vec with room for the requested number of slots
+static auto bestFit (uint32_t needs) -> VecSlot* {
+    for (auto b = binOf(needs); b < NUM_BINS; ++b) {
+        VecSlot* best = nullptr;
+        for (auto p = freeBins[b]; p != nullptr; p = links(*p).next)
+            if (p + needs <= p->next && (best == nullptr ||
+                                            p->next - p < best->next - best)) {
+                best = p;
+                if (p + needs == p->next)
+                    break; // can't do better than an exact fit
+            }
+        if (best != nullptr)
+            return best;
+    }
+    return nullptr;
+}
+
 void monty::vecInit (void* base, size_t size) {
     //assert(size > 2 * VSZ);
 
@@ -41,17 +137,130 @@ void monty::vecInit (void* base, size_t size) {
 
     vecLow = vecHigh = (VecSlot*) base;
     vecTop = (uint8_t*) base + size;
+    compactNext = pickNext = nullptr;
+    vecUsed = 0;
+    clearFree();
+}
+
+// vecs which are not kept become free slots in the image, see vecAdopt
+void monty::vecImage (void (*out) (void const*, uint32_t),
+                        auto (*keep) (Vec const&) -> bool) {
+    for (auto slot = vecLow; slot < vecHigh; ) {
+        uint32_t n = slot->isFree() ? slot->next - slot
+                                    : numVecSlots(slot->owner->cap());
+        if (slot->isFree() || keep(*slot->owner))
+            out(slot, n * VSZ);
+        else {
+            VecSlot head {nullptr, slot + n};
+            out(&head, VSZ);
+            out(slot + 1, (n - 1) * VSZ);
+        }
+        slot += n;
+    }
+}
+
+// the pool holds an image, from vecLow up to high: re-index its free vecs
+void monty::vecAdopt (void* high) {
+    assert(vecLow <= high && (uintptr_t) high <= (uintptr_t) vecTop);
+    vecHigh = (VecSlot*) high;
+    compactNext = pickNext = nullptr;
+    vecUsed = 0;
+    clearFree();
+    for (auto slot = vecLow; slot < vecHigh; )
+        if (slot->isFree()) {
+            addFree(*slot);
+            slot = slot->next;
+        } else {
+            auto n = numVecSlots(slot->owner->cap());
+            vecUsed += n;
+            slot += n;
+        }
+}
+
+// room for this many bytes above vecHigh, this will grow the pool if needed
+auto monty::vecReserve (uint32_t bytes) -> bool {
+    auto end = (uint8_t*) vecHigh + bytes;
+    return end <= vecTop || growPool(end);
+}
+
+void monty::vecFragLevel (uint8_t percent) {
+    fragLevel = percent;
+}
+
+auto monty::vecCheck () -> bool {
+    uint32_t span = vecHigh - vecLow;
+    auto gaps = span - vecUsed;
+    return gaps > 0 && gaps * 100 >= fragLevel * span;
 }
 
-// combine this free vec with all following free vecs
+// find the window with the most free slots before its last used vec, i.e. the
+// free space which compacting that window will merge into one, the search adds
+// its work to the budget (in bytes), and returns false when it has run out:
+// the next call then resumes where this one left off
+// when done, compactNext is set, or left null if there is no window, or if
+// its free space is less than the fragmentation level calls for
+static auto pickWindow (uint32_t& work, uint32_t budget) -> bool {
+    if (pickNext == nullptr) {
+        pickNext = vecLow;
+        pickStart = pickEnd = nullptr;
+        pickBest = 0;
+    }
+    while (pickNext < vecHigh) {
+        auto slot = pickNext;
+        if (!slot->isFree()) {
+            pickNext += numVecSlots(slot->owner->cap());
+            continue;
+        }
+        if (work >= budget)
+            return false;
+        uint32_t free = 0, score = 0;
+        VecSlot* end = nullptr;
+        for (auto p = slot; p < vecHigh && p < slot + WINDOW; ) {
+            work += VSZ;
+            if (p->isFree()) {
+                free += p->next - p;
+                p = p->next;
+            } else {
+                score = free;
+                p += numVecSlots(p->owner->cap());
+                end = p;
+            }
+        }
+        if (score > pickBest) {
+            pickBest = score;
+            pickStart = slot;
+            pickEnd = end;
+        }
+        pickNext = slot->next;
+    }
+    pickNext = nullptr;
+    if (pickBest > 0 && pickBest * 100 >= fragLevel * WINDOW) {
+        compactNext = pickStart;
+        compactEnd = pickEnd;
+    }
+    return true;
+}
+
+// combine this free vec, which must not be indexed, with all following free
+// vecs, then index the result
 // return true if vecHigh has been lowered, i.e. this free vec is now gone
 static auto mergeVecs (VecSlot& slot) -> bool {
     assert(slot.isFree());
     auto& tail = slot.next;
-    while (tail < vecHigh && tail->isFree())
+    while (tail < vecHigh && tail->isFree()) {
+        if (tail == compactNext)
+            compactNext = &slot;
+        if (tail == pickNext)
+            pickNext = &slot;
+        if (tail == pickStart)
+            pickStart = &slot;
+        dropFree(*tail);
         tail = tail->next;
-    if (tail < vecHigh)
+    }
+    if (tail < vecHigh) {
+        addFree(slot);
         return false;
+    }
     assert((uintptr_t) &slot < (uintptr_t) vecTop);
     vecHigh = &slot;
     return true;
@@ -63,6 +272,7 @@ static void splitFreeVec (VecSlot& slot, VecSlot* tail) {
         return; // no room for a free slot
     slot.owner = nullptr;
     slot.next = tail;
+    addFree(slot);
 }
 
 auto Vec::slots () const -> uint32_t {
@@ -70,23 +280,38 @@ auto Vec::slots () const -> uint32_t {
 }
 
 auto Vec::findSpace (uint32_t needs) -> void* {
-    auto slot = (VecSlot*) vecLow;               // scan all vectors
-    while (slot < vecHigh)
-        if (!slot->isFree())                    // skip used slots
-            slot += slot->owner->slots();
-        else if (mergeVecs(*slot))              // no more free slots
-            break;
-        else if (slot + needs > slot->next)     // won't fit
-            slot = slot->next;
-        else {                                  // fits, may need to split
-            splitFreeVec(slot[needs], slot->next);
-            break;                              // found existing space
-        }
-    if (slot == vecHigh) {
-        if ((uintptr_t) (vecHigh + needs) > (uintptr_t) vecTop)
-            assert(false);
-            //return panicOutOfMemory(); // no space, and no room to expand
+    auto slot = bestFit(needs);
+    if (slot != nullptr) {                      // use the best indexed fit
+        dropFree(*slot);
+        splitFreeVec(slot[needs], slot->next);
+    } else if ((uintptr_t) (vecHigh + needs) <= (uintptr_t) vecTop) {
+        slot = vecHigh;                         // extend the pool
         vecHigh += needs;
+    } else {
+        slot = (VecSlot*) vecLow;               // scan all vectors, merging
+        while (slot < vecHigh) {
+            if (!slot->isFree()) {              // skip used slots
+                slot += slot->owner->slots();
+                continue;
+            }
+            dropFree(*slot);
+            if (mergeVecs(*slot))               // no more free slots
+                break;
+            if (slot + needs > slot->next)      // won't fit
+                slot = slot->next;
+            else {                              // fits, may need to split
+                dropFree(*slot);
+                splitFreeVec(slot[needs], slot->next);
+                break;                          // found existing space
+            }
+        }
+        if (slot == vecHigh) {
+            if ((uintptr_t) (vecHigh + needs) > (uintptr_t) vecTop &&
+                    !growPool(vecHigh + needs))
+                assert(false);
+                //return panicOutOfMemory(); // no space, and no room to expand
+            vecHigh += needs;
+        }
     }
     slot->owner = this;
     return slot;
@@ -121,7 +346,7 @@ union VecStats {
     };
     int v [15];
 };
-VecStats vecStats;
+ISOLATE VecStats vecStats;
 
 auto Vec::adj (size_t sz) -> bool {
     if (_data != nullptr && !inPool(_data))
@@ -155,10 +380,19 @@ auto Vec::adj (size_t sz) -> bool {
             _data = nullptr;
         } else {                                // resize
             auto tail = slot + capas;
-            if (tail < vecHigh && tail->isFree())
+            if (tail < vecHigh && tail->isFree()) {
+                dropFree(*tail);
                 mergeVecs(*tail);
+            }
+            if (tail == compactNext)            // it might get absorbed
+                compactNext = slot;
+            if (tail == pickNext)
+                pickNext = slot;
+            if (tail == pickStart)
+                pickStart = slot;
             if (tail == vecHigh) {              // easy resize
-                if ((uintptr_t) (slot + needs) > (uintptr_t) vecTop)
+                if ((uintptr_t) (slot + needs) > (uintptr_t) vecTop &&
+                        !growPool(slot + needs))
                     //return panicOutOfMemory(), false;
                     assert(false);
                 vecHigh += (int) (needs - capas);
@@ -173,9 +407,13 @@ auto Vec::adj (size_t sz) -> bool {
                 _data = nslot->payload();
                 slot->owner = nullptr;
                 slot->next = slot + capas;
-            } else                              // use (part of) next free
+                mergeVecs(*slot);
+            } else {                            // use (part of) next free
+                dropFree(*tail);
                 splitFreeVec(slot[needs], tail->next);
+            }
         }
+        vecUsed += needs - capas;
         // clear newly added bytes
         auto obytes = _capa;
         _capa = needs > 0 ? needs * VSZ - PSZ : 0;
@@ -203,9 +441,66 @@ void Vec::compact () {
             newHigh += n;
         }
     vecHigh = newHigh;
+    compactNext = pickNext = nullptr;
+    clearFree();
     assert((uintptr_t) vecHigh < (uintptr_t) vecTop);
 }
 
+// move vecs down into the free space before them, until the budget in bytes
+// has been used up, but always at least one, so that big vecs move as well
+// windows are compacted in order of fragmentation, until none are left which
+// exceed the fragmentation level, the search for them counts as work as well
+auto Vec::compactStep (uint32_t budget) -> bool {
+    uint32_t moved = 0;
+    while (true) {
+        if (compactNext == nullptr) {
+            if (moved >= budget || !pickWindow(moved, budget))
+                return false;
+            if (compactNext == nullptr)
+                break;
+        }
+        while (compactNext < compactEnd && compactNext < vecHigh) {
+            auto slot = compactNext;
+            if (!slot->isFree()) {
+                compactNext += slot->owner->slots();
+                continue;
+            }
+            dropFree(*slot);
+            if (mergeVecs(*slot))               // only free space left
+                break;
+            auto live = slot->next;
+            if (live >= compactEnd)             // the rest is outside
+                break;
+            auto n = live->owner->slots();
+            if (moved > 0 && moved + n * VSZ > budget)
+                return false;
+            dropFree(*slot);
+            auto gap = live - slot;
+            live->owner->_data = slot->payload();
+            memmove(slot, live, n * VSZ);
+            compactNext = slot + n;             // the gap moves up
+            compactNext->owner = nullptr;
+            compactNext->next = compactNext + gap;
+            addFree(*compactNext);
+            moved += n * VSZ;
+        }
+        compactNext = nullptr;
+    }
+    ++vecStats.compacts;
+    return true;
+}
+
+void Vec::walk (void (*fun) (Vec const&, uint32_t)) {
+    for (auto slot = vecLow; slot < vecHigh; )
+        if (slot->isFree())
+            slot = slot->next;
+        else {
+            auto n = slot->owner->slots();
+            fun(*slot->owner, n * VSZ);
+            slot += n;
+        }
+}
+
 #if DOCTEST
 #include <doctest.h>
 namespace {
@@ -1,11 +1,38 @@
+// All mutable VM state is kept per isolate. On native builds an isolate is a
+// thread, so that several independent VMs can run side by side in a single
+// process, each with its own memory pools and tasks (see nat-py's "-j" flag).
+#ifndef ISOLATE
+#if NATIVE
+#define ISOLATE thread_local
+#else
+#define ISOLATE
+#endif
+#endif
+
 namespace monty {
     struct VecSlot; // opaque
+    struct Vec;
 
-    extern VecSlot *vecLow, *vecHigh;
-    extern uint8_t* vecTop;
+    extern ISOLATE VecSlot *vecLow, *vecHigh;
+    extern ISOLATE uint8_t* vecTop;
 
     void vecInit (void* ptr, size_t len);
 
+    // optional, to let the pool grow up instead of running out of memory:
+    // returns a new, higher vecTop with at least the requested bytes, or null
+    extern ISOLATE auto (*vecGrow) (uint32_t bytes) -> void*;
+
+    // heap images, see dash4.cpp: vecImage writes the pool out, with the vecs
+    // which are not kept turned into free space, vecAdopt takes over an image
+    // which has been copied in at vecLow, up to high
+    void vecImage (void (*out) (void const*, uint32_t),
+                    auto (*keep) (Vec const&) -> bool);
+    void vecAdopt (void* high);
+    auto vecReserve (uint32_t bytes) -> bool; // make room, via vecGrow if set
+
+    void vecFragLevel (uint8_t percent); // default 0, i.e. compact any gap
+    auto vecCheck () -> bool; // true if compaction is called for
+
     struct Vec {
         constexpr Vec () =default;
         constexpr Vec (void const* data, uint32_t capa =0)
@@ -16,6 +43,8 @@ namespace monty {
             return vecLow < p && p < vecHigh;
         }
         static void compact (); // reclaim and compact unused vector space
+        static auto compactStep (uint32_t budget) -> bool; // true when done
+        static void walk (void (*) (Vec const&, uint32_t bytes)); // all vecs
 
         auto cap () const { return _capa; }
         auto ptr () const { return _data; }
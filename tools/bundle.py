@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+
+# Module bundles: many compiled modules in a single file, with a hash index
+#
+# Usage: bundle.py -o outfile infile...
+#
+#   files with a ".py" extension are compiled to ".mpy" and then included,
+#   all other files are included as is (".mpy", ".mpx", and data files)
+#
+#   the extension is omitted from the names stored, which are at most 15 chars
+#
+# The layout uses the same 32-byte records as MRFS (see v1.3/lib/mrfs/), but
+# with all fields up front so that each payload starts on a 32-byte boundary:
+#
+#   index:   'mtyB', number of slots, "bundle", time, crc, then 4-byte slots
+#   modules: 'mty0', payload size, name, time, crc, then the payload
+#
+# Each slot is 0 or the offset of a module, hashed by name (FNV-1a) with
+# linear probing. The index is at most half full, so lookups are very short.
+
+import os, subprocess, sys
+from binascii import crc32
+from datetime import datetime
+from struct import pack
+
+def fnv1a(name):
+    h = 2166136261
+    for b in name:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+def compileIfOutdated(fn):
+    root, ext = os.path.splitext(fn)
+    if ext != '.py':
+        return fn
+    mpy = root + ".mpy"
+    mtime = os.stat(fn).st_mtime
+    if not os.path.isfile(mpy) or (mtime >= os.stat(mpy).st_mtime):
+        out = subprocess.getoutput("mpy-cross -s %s %s" %
+                                        (os.path.basename(fn), fn))
+        if out:
+            raise SystemExit(out)
+    return mpy
+
+def record(magic, size, name, date, dat):
+    hdr = pack('4s I 16s I', magic, size, name, date)
+    crc = crc32(dat, crc32(hdr))
+    return hdr + pack('I', crc) + dat + (-len(dat)&31) * b'\0'
+
+ofile = None
+modules = {}
+args = iter(sys.argv[1:])
+for fn in args:
+    if fn == '-o':
+        ofile = next(args)
+        continue
+
+    if not os.path.isfile(fn):
+        raise SystemExit(fn + '?')
+
+    info = os.stat(fn)
+    date = int(datetime.fromtimestamp(info.st_mtime).strftime('%y%m%d%H%M'))
+    nam = os.path.splitext(os.path.basename(fn))[0].encode()
+    if len(nam) > 15:
+        raise SystemExit(fn + ': name too long')
+
+    with open(compileIfOutdated(fn), 'rb') as fd:
+        modules[nam] = (date, fd.read()) # last one wins
+
+if ofile is None or not modules:
+    raise SystemExit('Usage: bundle.py -o outfile infile...')
+
+nslots = 8
+while nslots < 2 * len(modules):
+    nslots *= 2
+
+slots = [0] * nslots
+body = b''
+pos = 32 + 4 * nslots + (-4 * nslots & 31)
+for nam, (date, dat) in modules.items():
+    i = fnv1a(nam) & (nslots - 1)
+    while slots[i] != 0:
+        i = (i + 1) & (nslots - 1)
+    slots[i] = pos + len(body)
+    body += record(b'mty0', len(dat), nam, date, dat)
+
+now = int(datetime.now().strftime('%y%m%d%H%M'))
+index = pack('%dI' % nslots, *slots)
+
+with open(ofile, 'wb') as fd:
+    fd.write(record(b'mtyB', nslots, b'bundle', now, index))
+    fd.write(body)
+
+print('%s: %d modules, %d bytes' % (ofile, len(modules), pos + len(body)))
@@ -128,12 +128,13 @@ def MODULE(block, mod):
     mods[arch].append(mod)
     return []
 
-# generate the final code to define the current module
-def MODULE_END(block):
+# generate the final code to define the current module, the optional arg is
+# a Lookup subclass, for attributes which can't be in the static map
+def MODULE_END(block, typ="Lookup"):
     m = flags.mod
     assert m != ""
     flags.mod = ""
-    return ["static Lookup const %s_attrs (%s_map);" % (m, m),
+    return ["static %s const %s_attrs (%s_map);" % (typ, m, m),
             "Module ext_%s (%s, %s_attrs);" % (m, q(m), m)]
 
 # emit the definitions to find all known modules
@@ -8,6 +8,8 @@ help='
   m py        run native Python tests as a continuous TDD loop
   m ram       upload embedded C++ code to RAM as a continuous TDD loop
   m upy       upload embedded Python tests as a continuous TDD loop
+  m bundle    compile all Python tests into a single bundle, for nat-py
+  m scale     run all Python tests in 1, 2, 4, and 8 isolates at once
 
   m gen       pass source code through the code generator
   m ogen      pass source code through the code generator (old version)
@@ -42,6 +44,17 @@ cmd_py  () { cd apps/nat-py  && make tdd; }
 cmd_ram () { cd apps/emb-ram && make tdd; }
 cmd_upy () { cd apps/emb-upy && make tdd; }
 
+cmd_bundle () { tools/bundle.py -o py/tests.mtb py/*.py; }
+
+cmd_scale () {
+    cmd_bundle
+    cd apps/nat-py && make main
+    tests=$(cd ../../py && ls *.py | sed 's/\.py$//')
+    for n in 1 2 4 8; do
+        MONTY_BUNDLE=../../py/tests.mtb ./main -j $n $tests | tail -1
+    done
+}
+
 cmd_tt () {
     while getopts abc: f; do
         case $f in
@@ -5,6 +5,15 @@
 #include <cstdio>
 #include <ctime>
 
+#if __linux__
+#include <linux/futex.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <thread>
+#include <unistd.h>
+#endif
+
 using namespace monty;
 
 static void* pool;
@@ -42,6 +51,68 @@ auto monty::vmLaunch (void const*) -> Context* {
 }
 #endif
 
+#if __linux__
+// On Linux, a background thread waits for all timers with epoll, and sets
+// their pending bits as interrupts would do on a µC. This also interrupts a running VM, which checks these bits. Idling then
+// blocks on a futex for Stacklet::pending, i.e. until some bit gets set: idle
+// tasks use no CPU at all, and wakeups are immediate.
+
+constexpr uint32_t TIMER_FLAG = 1U << 31; // in epoll data, next to the id
+
+static int epollFd = -1;
+
+static auto futex (int op, uint32_t val) -> long {
+    return syscall(SYS_futex, (uint32_t*) &Stacklet::pending, op, val,
+                    nullptr, nullptr, 0);
+}
+
+static void watcher () {
+    epoll_event events [8];
+    while (true) {
+        auto n = epoll_wait(epollFd, events, 8, -1);
+        for (int i = 0; i < n; ++i) {
+            auto fd = (int) (events[i].data.u64 >> 32);
+            auto id = (uint32_t) events[i].data.u64;
+            if (id & TIMER_FLAG) {
+                uint64_t count; // must be read, to re-arm the timer
+                (void) read(fd, &count, sizeof count);
+            }
+            Context::setPending(id & ~TIMER_FLAG);
+        }
+        if (n > 0)
+            futex(FUTEX_WAKE_PRIVATE, 1); // there's only one VM thread
+    }
+}
+
+static auto watchFlags (int fd, uint32_t flags) -> bool {
+    epoll_event ev {};
+    ev.events = EPOLLIN | EPOLLET; // only report new data, not what's left
+    ev.data.u64 = (uint64_t) fd << 32 | flags;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+auto arch::timer (int ms, uint32_t id) -> int {
+    auto fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    timespec ts { ms / 1000, ms % 1000 * 1000000L };
+    itimerspec its { ts, ts };
+    if (timerfd_settime(fd, 0, &its, nullptr) < 0 ||
+            !watchFlags(fd, id | TIMER_FLAG)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void arch::unwatch (int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+#else
+auto arch::timer (int, uint32_t) -> int { return -1; }
+void arch::unwatch (int) {}
+#endif
+
 void arch::init (int size) {
     setbuf(stdout, nullptr);
     if (size <= 0)
@@ -51,11 +122,20 @@ void arch::init (int size) {
 #if HAS_PYVM
     Event::triggers.append(0); // TODO yuck, reserve 1st entry for VM
 #endif
+#if __linux__
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    assert(epollFd >= 0);
+    std::thread (watcher).detach();
+#endif
 }
 
 void arch::idle () {
+#if __linux__
+    futex(FUTEX_WAIT_PRIVATE, 0); // returns at once if any bit is set
+#else
     timespec ts { 0, 100000 };
     nanosleep(&ts, &ts); // 100 µs, i.e. 10% of ticks' 1 ms resolution
+#endif
 }
 
 static void cleanup () {
@@ -4,4 +4,9 @@ namespace arch {
     void init (int =0);
     void idle ();
     auto done () -> int;
+
+    // Linux only: a background thread sets the given pending bit whenever
+    // the periodic timer fires
+    auto timer (int ms, uint32_t id) -> int; // returns its fd, or -1
+    void unwatch (int fd); // the caller closes the fd, also for timers
 }
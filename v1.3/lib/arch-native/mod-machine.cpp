@@ -1,14 +1,16 @@
 #include <monty.h>
+#include "arch.h"
 
 #include <cassert>
 #include <ctime>
+#include <unistd.h>
 
 using namespace monty;
 
 //CG: module machine
 
 Event tickEvent;
-int ms, tickerId;
+int ms, tickerId, tickerFd = -1;
 uint32_t start, last;
 
 static auto micros () -> uint64_t {
@@ -29,7 +31,9 @@ static auto msNow () -> Value {
     return (us - begin) / 1000; // make all runs start out the same way
 }
 
-// simulate in software, see INNER_HOOK in arch.h and monty/pyvm.h
+#if !__linux__
+// simulate in software, see INNER_HOOK in monty/stack.cpp and pyvm/pyvm.cpp,
+// on Linux, a timerfd sets the pending bit instead, see arch::timer
 void timerHook () {
     uint32_t t = msNow();
     if (ms > 0 && (t - start) / ms != last) {
@@ -38,15 +42,29 @@ void timerHook () {
             Context::setPending(tickerId);
     }
 }
+#endif
 
 //CG1 bind ticker ? arg:i
 static auto f_ticker (ArgVec const& args, int arg) -> Value {
+    if (tickerFd >= 0) {
+        arch::unwatch(tickerFd);
+        close(tickerFd);
+        tickerFd = -1;
+    }
     if (args.size() > 0) {
         ms = arg;
         start = msNow(); // set first timeout relative to now
         last = 0;
         tickerId = tickEvent.regHandler();
         assert(tickerId > 0);
+#if __linux__
+        tickerFd = arch::timer(ms, tickerId);
+        if (tickerFd < 0) {
+            tickEvent.deregHandler();
+            tickerId = 0;
+            return {E::OSError, "can't start ticker", ms};
+        }
+#endif
     } else {
         tickEvent.deregHandler();
         tickEvent.clear();
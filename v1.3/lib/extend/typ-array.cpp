@@ -3,11 +3,10 @@
 #include "monty.h"
 #include "typ-array.h"
 #include <cassert>
+#include <cstring>
 
 using namespace monty;
 
-Lookup const Array::attrs;
-
 struct Accessor {
     virtual auto get (ByteVec&, uint32_t) const -> Value  = 0;
     virtual void set (ByteVec&, uint32_t, Value) const = 0;
@@ -57,16 +56,31 @@ struct AccessAsBits : Accessor {                    // P T N
         auto& e = vec[pos>>shft];
         e = (e & ~(mask << b)) | (((int) val & mask) << b);
     }
+    // the length is tracked in bytes, so num must fill whole bytes, but pos
+    // can be anywhere: the bytes are moved as a block, then the one byte
+    // holding items on both sides of pos gets split up or merged back
     void ins (ByteVec& vec, uint32_t pos, uint32_t num) const override {
-        assert((pos & rest) == 0 && (num & rest) == 0);
+        assert((num & rest) == 0);
+        auto k = pos >> shft, nb = num >> shft;
         vec._fill >>= shft;
-        vec.insert(pos >> shft, num >> shft);
+        auto split = (pos & rest) != 0 && nb > 0 && k < vec._fill;
+        vec.insert(k, nb);
         vec._fill <<= shft;
+        if (split) {
+            uint8_t lo = (1 << bits * (pos & rest)) - 1;
+            vec[k] = vec[k+nb] & lo;
+            vec[k+nb] &= ~lo;
+        }
     }
     void del (ByteVec& vec, uint32_t pos, uint32_t num) const override {
-        assert((pos & rest) == 0 && (num & rest) == 0);
+        assert((num & rest) == 0);
+        auto k = pos >> shft, nb = num >> shft;
         vec._fill >>= shft;
-        vec.remove(pos >> shft, num >> shft);
+        if ((pos & rest) != 0 && nb > 0 && k + nb < vec._fill) {
+            uint8_t lo = (1 << bits * (pos & rest)) - 1;
+            vec[k+nb] = (vec[k] & lo) | (vec[k+nb] & ~lo);
+        }
+        vec.remove(k, nb);
         vec._fill <<= shft;
     }
 };
@@ -247,11 +261,10 @@ auto Array::create (ArgVec const& args, Type const*) -> Value {
     return new Array (type, len);
 }
 
-void Array::repr (Buffer& buf) const {
-    auto m = mode();
-    auto n = len();
-    buf.print("%d%c", n, m);
-    switch (m) {
+// number of bytes used by the packed array data
+static auto dataBytes (Array const& a) -> uint32_t {
+    auto n = a.len();
+    switch (a.mode()) {
         case 'q':                               n <<= 1; // fall through
         case 'l': case 'L':                     n <<= 1; // fall through
         case 'h': case 'H': case 'i': case 'I': n <<= 1; // fall through
@@ -259,13 +272,361 @@ void Array::repr (Buffer& buf) const {
         case 'P':                               n >>= 1; // fall through
         case 'T':                               n >>= 1; // fall through
         case 'N':                               n >>= 1; break;
-        case 'v': case 'V': n = ((uint16_t const*) begin())[len()]; break;
+        case 'v': case 'V': n = ((uint16_t const*) a.begin())[a.len()]; break;
     }
+    return n;
+}
+
+void Array::repr (Buffer& buf) const {
+    buf.print("%d%c", len(), mode());
+    auto n = dataBytes(*this);
     auto p = (uint8_t const*) begin();
     for (uint32_t i = 0; i < n; ++i)
         buf.print("%02x", p[i]);
 }
 
+// Bulk operations work on the packed data of the integer array modes. The
+// element-wise kernels use 16-byte vectors (GCC/Clang vector extensions),
+// which map onto SSE/AVX or NEON where available, and are lowered to plain
+// scalar loops on targets without SIMD support. Results wrap around, as in C.
+
+template< typename T >
+struct SimdOf { typedef T V __attribute__ ((vector_size (16))); };
+
+// call f with a typed pointer to the array data, for each integer array mode
+template< typename F >
+static auto withData (Array const& a, F f) -> Value {
+    auto p = (void*) a.begin();
+    switch (a.mode()) {
+        case 'b':           return f((int8_t*) p);
+        case 'B':           return f((uint8_t*) p);
+        case 'h': case 'i': return f((int16_t*) p);
+        case 'H': case 'I': return f((uint16_t*) p);
+        case 'l':           return f((int32_t*) p);
+        case 'L':           return f((uint32_t*) p);
+        case 'q':           return f((int64_t*) p);
+    }
+    return {E::TypeError, "not an integer array", a.mode()};
+}
+
+// apply op to each element and either the matching element in src, or val
+// the tail is padded out to a full vector, so all items use the same code
+template< typename T, typename F >
+static void elementWise (T* dst, T const* src, int64_t val, uint32_t n, F op) {
+    using V = typename SimdOf<T>::V;
+    constexpr uint32_t K = sizeof (V) / sizeof (T);
+    V b;
+    for (uint32_t k = 0; k < K; ++k)
+        b[k] = val;
+    for (uint32_t i = 0; i < n; i += K) {
+        auto bytes = (n - i < K ? n - i : K) * sizeof (T);
+        V a {};
+        memcpy(&a, dst + i, bytes);
+        if (src != nullptr)
+            memcpy(&b, src + i, bytes);
+        a = op(a, b);
+        memcpy(dst + i, &a, bytes);
+    }
+}
+
+// shared code for add, sub, and mul: arg is an int or a same-mode array
+template< typename F >
+static auto binaryOp (Array& a, Value arg, F op) -> Value {
+    auto n = a.len();
+    Array const* other = nullptr;
+    int64_t val = 0;
+    if (arg.isInt())
+        val = (int) arg;
+    else if (arg.ifType<Int>() != nullptr)
+        val = arg.asInt();
+    else {
+        other = &arg.asType<Array>();
+        if (other->mode() != a.mode())
+            return {E::TypeError, "array mode mismatch", other->mode()};
+        if (other->len() != n)
+            return {E::ValueError, "array length mismatch", (int) other->len()};
+    }
+    return withData(a, [&](auto p) -> Value {
+        auto src = other != nullptr ? (decltype(p)) other->begin() : nullptr;
+        elementWise(p, src, val, n, op);
+        return {};
+    });
+}
+
+auto Array::add (Value arg) -> Value {
+    return binaryOp(*this, arg, [](auto x, auto y) { return x + y; });
+}
+
+auto Array::sub (Value arg) -> Value {
+    return binaryOp(*this, arg, [](auto x, auto y) { return x - y; });
+}
+
+auto Array::mul (Value arg) -> Value {
+    return binaryOp(*this, arg, [](auto x, auto y) { return x * y; });
+}
+
+// a.scale(mul, shift=0): fixed-point scaling, i.e. (x * mul) >> shift
+auto Array::scale (ArgVec const& args) -> Value {
+    if (args.size() != 2 && args.size() != 3)
+        return {E::TypeError, "scale needs 1 or 2 args", (int) args.size() - 1};
+    int64_t mul = args[1].asInt();
+    int shift = args.size() > 2 ? (int) args[2] : 0;
+    if (shift < 0 || shift >= 64)
+        return {E::ValueError, "bad shift", shift};
+    auto n = len();
+    return withData(*this, [=](auto p) -> Value {
+        int64_t t;
+        // check all products first, so an overflow leaves the array intact
+        for (uint32_t i = 0; i < n; ++i)
+            if (__builtin_mul_overflow((int64_t) p[i], mul, &t))
+                return {E::ValueError, "scale overflow", (int) i};
+        for (uint32_t i = 0; i < n; ++i)
+            p[i] = ((int64_t) p[i] * mul) >> shift;
+        return {};
+    });
+}
+
+auto Array::sum () -> Value {
+    auto n = len();
+    return withData(*this, [=](auto p) -> Value {
+        int64_t r = 0;
+        for (uint32_t i = 0; i < n; ++i)
+            r += p[i];
+        return Int::make(r);
+    });
+}
+
+auto Array::min () -> Value {
+    auto n = len();
+    if (n == 0)
+        return {E::ValueError, "empty array"};
+    return withData(*this, [=](auto p) -> Value {
+        auto r = p[0];
+        for (uint32_t i = 1; i < n; ++i)
+            r = p[i] < r ? p[i] : r;
+        return Int::make(r);
+    });
+}
+
+auto Array::max () -> Value {
+    auto n = len();
+    if (n == 0)
+        return {E::ValueError, "empty array"};
+    return withData(*this, [=](auto p) -> Value {
+        auto r = p[0];
+        for (uint32_t i = 1; i < n; ++i)
+            r = p[i] > r ? p[i] : r;
+        return Int::make(r);
+    });
+}
+
+auto Array::dot (Value arg) -> Value {
+    auto& other = arg.asType<Array>();
+    if (other.mode() != mode())
+        return {E::TypeError, "array mode mismatch", other.mode()};
+    auto n = len();
+    if (other.len() != n)
+        return {E::ValueError, "array length mismatch", (int) other.len()};
+    return withData(*this, [&](auto p) -> Value {
+        auto q = (decltype(p)) other.begin();
+        int64_t r = 0;
+        for (uint32_t i = 0; i < n; ++i)
+            r += (int64_t) p[i] * q[i];
+        return Int::make(r);
+    });
+}
+
+// copy all items from another integer array, converting to this array's mode
+// conversion goes through a small int64_t buffer, to avoid N x M kernels
+auto Array::assign (Value arg) -> Value {
+    auto& src = arg.asType<Array>();
+    // both arrays must be integer-based, check before changing the size
+    auto v = withData(src, [](auto) -> Value { return {}; });
+    if (v.isNil())
+        v = withData(*this, [](auto) -> Value { return {}; });
+    if (!v.isNil())
+        return v;
+    auto n = src.len();
+    if (len() > n)
+        remove(n, len() - n);
+    else if (len() < n)
+        insert(len(), n - len());
+    if (src.mode() == mode())
+        return withData(*this, [&](auto p) -> Value {
+            memcpy(p, src.begin(), n * sizeof *p);
+            return {};
+        });
+    int64_t buf [32];
+    for (uint32_t pos = 0; pos < n; pos += 32) {
+        auto m = n - pos < 32 ? n - pos : 32;
+        v = withData(src, [&](auto p) -> Value {
+            for (uint32_t i = 0; i < m; ++i)
+                buf[i] = p[pos+i];
+            return {};
+        });
+        if (v.isNil())
+            v = withData(*this, [&](auto p) -> Value {
+                for (uint32_t i = 0; i < m; ++i)
+                    p[pos+i] = buf[i];
+                return {};
+            });
+        if (!v.isNil())
+            return v;
+    }
+    return {};
+}
+
+// Bit operations process 64 bits at a time, using 1-, 2-, and 4-bit items in
+// the 'P', 'T', and 'N' modes, else whole integers in the other array modes.
+
+static auto bitLog (char mode) -> int {
+    switch (mode) {
+        case 'P': return 0;
+        case 'T': return 1;
+        case 'N': return 2;
+    }
+    return -1;
+}
+
+// load up to 8 bytes as a little-endian word, missing bytes are zero
+static auto loadWord (uint8_t const* p, uint32_t bytes) -> uint64_t {
+    uint64_t w = 0;
+    memcpy(&w, p, bytes < 8 ? bytes : 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+auto Array::popcount () -> Value {
+    auto p = (uint8_t const*) begin();
+    auto n = dataBytes(*this);
+    int64_t r = 0;
+    for (uint32_t i = 0; i < n; i += 8)
+        r += __builtin_popcountll(loadWord(p + i, n - i));
+    return Int::make(r);
+}
+
+// find the first item at or after start which is non-zero, or zero if !set
+static auto findItem (Array& a, uint32_t start, bool set) -> Value {
+    auto n = a.len();
+    auto L = bitLog(a.mode());
+    if (L < 0)
+        return withData(a, [=](auto p) -> Value {
+            for (uint32_t i = start; i < n; ++i)
+                if ((p[i] != 0) == set)
+                    return (int) i;
+            return -1;
+        });
+
+    // collapse each item into its lowest bit, to find non-zero items
+    static uint64_t const lowBits [] = {
+        ~0ULL, 0x5555555555555555ULL, 0x1111111111111111ULL,
+    };
+    auto perWord = 64 >> L;
+    auto p = (uint8_t const*) a.begin();
+    auto nbytes = dataBytes(a);
+    for (uint32_t base = start & ~(perWord - 1); base < n; base += perWord) {
+        auto off = (base << L) >> 3;
+        auto w = loadWord(p + off, nbytes - off);
+        if (L > 0)
+            w |= w >> 1;
+        if (L > 1)
+            w |= w >> 2;
+        w &= lowBits[L];
+        if (!set)
+            w ^= lowBits[L];
+        if (base < start)
+            w &= ~0ULL << ((start - base) << L);
+        if (w != 0) {
+            auto i = base + (__builtin_ctzll(w) >> L);
+            return i < n ? (int) i : -1;
+        }
+    }
+    return -1;
+}
+
+auto Array::ffs (ArgVec const& args) -> Value {
+    return findItem(*this, args.size() > 1 ? (int) args[1] : 0, true);
+}
+
+auto Array::ffc (ArgVec const& args) -> Value {
+    return findItem(*this, args.size() > 1 ? (int) args[1] : 0, false);
+}
+
+// a.fill(val, start=0, end=len): the whole bytes inside the range are set
+// with memset, only the items at either end are set individually
+auto Array::fill (ArgVec const& args) -> Value {
+    if (args.size() < 2 || args.size() > 4)
+        return {E::TypeError, "fill needs 1 to 3 args", (int) args.size() - 1};
+    int val = args[1];
+    uint32_t n = len();
+    uint32_t from = args.size() > 2 ? (int) args[2] : 0;
+    uint32_t to = args.size() > 3 ? (int) args[3] : n;
+    if (to > n)
+        to = n;
+    auto L = bitLog(mode());
+    if (L < 0)
+        return withData(*this, [=](auto p) -> Value {
+            for (uint32_t i = from; i < to; ++i)
+                p[i] = val;
+            return {};
+        });
+
+    auto rest = (8 >> L) - 1;
+    auto s = sel();
+    auto& acc = *accessors[s];
+    _fill &= 0x07FFFFFF;
+    while (from < to && (from & rest) != 0)
+        acc.set(*this, from++, val);
+    while (from < to && (to & rest) != 0)
+        acc.set(*this, --to, val);
+    if (from < to) {
+        static uint8_t const spread [] = { 0xFF, 0x55, 0x11 };
+        auto mask = (1 << (1 << L)) - 1;
+        memset(begin() + (from >> (3 - L)), (val & mask) * spread[L],
+                (to - from) >> (3 - L));
+    }
+    _fill |= s << LEN_BITS;
+    return {};
+}
+
+// shared code for iand, ior, ixor: combine with a same-mode array, in place
+template< typename F >
+static auto bitwiseOp (Array& a, Value arg, F op) -> Value {
+    auto& other = arg.asType<Array>();
+    if (other.mode() != a.mode())
+        return {E::TypeError, "array mode mismatch", other.mode()};
+    if (other.len() != a.len())
+        return {E::ValueError, "array length mismatch", (int) other.len()};
+    auto d = (uint8_t*) a.begin();
+    auto s = (uint8_t const*) other.begin();
+    auto n = dataBytes(a);
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, d + i, 8);
+        memcpy(&y, s + i, 8);
+        x = op(x, y);
+        memcpy(d + i, &x, 8);
+    }
+    for (; i < n; ++i)
+        d[i] = op(d[i], s[i]);
+    return {};
+}
+
+auto Array::iand (Value arg) -> Value {
+    return bitwiseOp(*this, arg, [](auto x, auto y) { return x & y; });
+}
+
+auto Array::ior (Value arg) -> Value {
+    return bitwiseOp(*this, arg, [](auto x, auto y) { return x | y; });
+}
+
+auto Array::ixor (Value arg) -> Value {
+    return bitwiseOp(*this, arg, [](auto x, auto y) { return x ^ y; });
+}
+
 #if DOCTEST
 #include <doctest.h>
 
@@ -405,6 +766,113 @@ TEST_CASE("array") {
         }
     }
 
+    SUBCASE("arrayBulk") {
+        constexpr int N = 37; // not a multiple of the vector width
+        static char const types [] = "bBhHlLq";
+        for (auto typ = types; *typ != 0; ++typ) {
+            Array a (*typ, N), b (*typ, N);
+            for (int i = 0; i < N; ++i) {
+                a.setAt(i, i);
+                b.setAt(i, 2);
+            }
+
+            CHECK(a.add(b).isNil());
+            CHECK(N*(N-1)/2 + 2*N == a.sum().asInt());
+            CHECK(a.sub(1).isNil());
+            CHECK(1 == a.getAt(0).asInt());
+            CHECK(N == a.getAt(N-1).asInt());
+            CHECK(a.mul(b).isNil());
+            CHECK(2 == a.min().asInt());
+            CHECK(2*N == a.max().asInt());
+            CHECK(2*(N*(N+1)) == a.dot(b).asInt()); // sum of 2*(2i+2)
+
+            Value args [] = {a, 3, 1};
+            CHECK(a.scale({args}).isNil());
+            CHECK(3 == a.getAt(0).asInt());
+            CHECK(3*N == a.getAt(N-1).asInt());
+
+            Array c ('h', 5);
+            CHECK(c.assign(a).isNil());
+            CHECK(N == c.len());
+            CHECK(a.sum().asInt() == c.sum().asInt());
+            CHECK(b.assign(a).isNil());
+            CHECK(3*N == b.max().asInt());
+        }
+
+        Array w ('b', 20);
+        w.setAt(19, 127);
+        w.add(1);
+        CHECK(1 == w.getAt(0).asInt());
+        CHECK(-128 == w.getAt(19).asInt());
+
+        Array u ('H', 3);
+        u.setAt(0, 65535);
+        u.setAt(1, 1000);
+        Array v ('b', 0);
+        v.assign(u);
+        CHECK(-1 == v.getAt(0).asInt());
+        CHECK(-24 == v.getAt(1).asInt());
+    }
+
+    SUBCASE("arrayBits") {
+        Array a ('P', 64), b ('P', 64);
+        CHECK(0 == a.popcount().asInt());
+        CHECK(-1 == (int) a.ffs({}));
+
+        Value args [] = {a, 1, 3, 50};
+        CHECK(a.fill({args}).isNil());
+        CHECK(47 == a.popcount().asInt());
+        CHECK(0 == (int) a.getAt(2));
+        CHECK(1 == (int) a.getAt(3));
+        CHECK(1 == (int) a.getAt(49));
+        CHECK(0 == (int) a.getAt(50));
+        CHECK(3 == (int) a.ffs({args, 1}));
+        CHECK(0 == (int) a.ffc({args, 1}));
+        Value from [] = {a, 10};
+        CHECK(10 == (int) a.ffs({from}));
+        CHECK(50 == (int) a.ffc({from}));
+        from[1] = 50;
+        CHECK(-1 == (int) a.ffs({from}));
+
+        b.setAt(0, 1);
+        b.setAt(3, 1);
+        b.setAt(63, 1);
+        CHECK(a.iand(b).isNil());
+        CHECK(1 == a.popcount().asInt());
+        CHECK(a.ior(b).isNil());
+        CHECK(3 == a.popcount().asInt());
+        CHECK(a.ixor(b).isNil());
+        CHECK(0 == a.popcount().asInt());
+
+        Array n ('N', 40);
+        Value nargs [] = {n, 9, 5, 40};
+        n.fill({nargs});
+        CHECK(0 == (int) n.getAt(4));
+        CHECK(9 == (int) n.getAt(5));
+        CHECK(9 == (int) n.getAt(39));
+        CHECK(35 * 2 == n.popcount().asInt());
+        CHECK(5 == (int) n.ffs({nargs, 1}));
+        n.setAt(20, 0);
+        Value at [] = {n, 6};
+        CHECK(20 == (int) n.ffc({at}));
+
+        Array t ('T', 16);
+        t.setAt(5, 3);
+        t.setAt(6, 1);
+        t.insert(3, 4); // not on a byte boundary
+        CHECK(20 == t.len());
+        CHECK(3 == (int) t.getAt(9));
+        CHECK(1 == (int) t.getAt(10));
+        CHECK(3 == t.popcount().asInt());
+        t.setAt(2, 2);
+        t.remove(3, 4);
+        CHECK(16 == t.len());
+        CHECK(2 == (int) t.getAt(2));
+        CHECK(3 == (int) t.getAt(5));
+        CHECK(1 == (int) t.getAt(6));
+        CHECK(4 == t.popcount().asInt());
+    }
+
     SUBCASE("listInsDel") {
         List l;
         CHECK(0 == l.size());
@@ -18,6 +18,28 @@ namespace monty {
         auto copy (Range const&) const -> Value override;
         auto store (Range const&, Object const&) -> Value override;
 
+        // bulk operations, working directly on the packed integer data
+        //CG: wrap Array add sub mul scale sum min max dot assign
+        auto add (Value) -> Value;
+        auto sub (Value) -> Value;
+        auto mul (Value) -> Value;
+        auto scale (ArgVec const&) -> Value;
+        auto sum () -> Value;
+        auto min () -> Value;
+        auto max () -> Value;
+        auto dot (Value) -> Value;
+        auto assign (Value) -> Value;
+
+        // bit operations, a word at a time
+        //CG: wrap Array popcount ffs ffc fill iand ior ixor
+        auto popcount () -> Value;
+        auto ffs (ArgVec const&) -> Value;
+        auto ffc (ArgVec const&) -> Value;
+        auto fill (ArgVec const&) -> Value;
+        auto iand (Value) -> Value;
+        auto ior (Value) -> Value;
+        auto ixor (Value) -> Value;
+
     private:
         auto sel () const -> uint8_t { return _fill >> LEN_BITS; }
     };
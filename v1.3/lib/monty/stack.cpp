@@ -4,7 +4,7 @@
 #include <cassert>
 #include <csetjmp>
 
-#if NATIVE
+#if NATIVE && !__linux__ // Linux uses a timerfd, see arch-native
 extern void timerHook ();
 #define INNER_HOOK  { timerHook(); }
 #else
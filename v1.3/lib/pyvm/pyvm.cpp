@@ -8,7 +8,7 @@
 #define SHOW_INSTR_PTR 0 // show instr ptr each time through inner loop
 //CG: off op_print # set to "on" to enable per-opcode debug output
 
-#if NATIVE
+#if NATIVE && !__linux__ // Linux uses a timerfd, see arch-native
 extern void timerHook ();
 #define INNER_HOOK  { timerHook(); }
 #else
@@ -25,3 +25,25 @@ f("L")
 f("N",8)
 f("T",8)
 f("P",8)
+
+a = array("h", 5)
+for i in range(5):
+    a[i] = i
+a.add(10)
+print(a.sum(), a.min(), a.max(), a.dot(a))
+b = array("q")
+b.assign(a)
+b.scale(3, 1)
+print(b)
+try:
+    b.scale(3, 64)
+except ValueError:
+    print("bad shift")
+try:
+    b.fill()
+except TypeError:
+    print("fill args")
+try:
+    b.assign(array("P", 8))
+except TypeError:
+    print(len(b), b.sum())